@@ -0,0 +1,1151 @@
+// Benchmark.cpp
+// ܲԣڲͬ²ļд
+#include "FileSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Geometry {
+    uint32_t blockSize;
+    uint32_t blockCount;
+};
+
+// ʧܵĴ0ʱ׼ʧ˳
+static int checkFailures = 0;
+
+// չ졢ûʽľͬܰԪڵĿУ
+// пӦԪ֮ĿԪݿλͼãдԭ
+static void checkFreshVolume(const Geometry& g) {
+    FileSystem fs(g.blockSize, g.blockCount);
+    uint64_t usable = fs.getBlockCount() - fs.getMetaBlocks();
+    uint64_t freeBefore = fs.freeBlocks();
+    uint32_t freeMeta = 0;
+    for (uint32_t b = 0; b < fs.getMetaBlocks(); b++) {
+        if (!fs.isBlockUsed(b)) freeMeta++;
+    }
+
+    std::string data(static_cast<size_t>(usable * fs.getBlockSize()), 'm');
+    bool filled = fs.createFile("fill") && fs.openFile("fill") && fs.writeFile("fill", data) &&
+        fs.freeBlocks() == 0 && fs.readFile("fill") == data;
+
+    bool ok = freeBefore == usable && freeMeta == 0 && filled;
+    printf("%6u B x %9u blocks: fresh volume %llu free of %llu usable, %u metadata blocks free, fill %s%s\n",
+        fs.getBlockSize(), fs.getBlockCount(), (unsigned long long)freeBefore, (unsigned long long)usable, freeMeta,
+        filled ? "ok" : "failed", ok ? "" : "  FAILED");
+    if (!ok) {
+        checkFailures++;
+    }
+}
+
+// дһļȫأͳƷٶȺͶд
+static void benchVolumeGrowth(const Geometry& g) {
+    FileSystem fs;
+    if (!fs.format(g.blockSize, g.blockCount)) {
+        printf("%6u B x %9u blocks: invalid or too large\n", g.blockSize, g.blockCount);
+        return;
+    }
+
+    uint64_t volumeBytes = uint64_t(g.blockSize) * g.blockCount;
+    uint64_t payload = std::min<uint64_t>(16 << 20, volumeBytes / 4);
+    const int fileCount = 64;
+    int fileSize = static_cast<int>(payload / fileCount);
+    std::string data(fileSize, 'x');
+
+    auto start = Clock::now();
+    for (int i = 0; i < fileCount; i++) {
+        std::string name = "f" + std::to_string(i);
+        fs.createFile(name);
+        fs.openFile(name);
+        fs.writeFile(name, data);
+    }
+    double writeSeconds = secondsSince(start);
+
+    start = Clock::now();
+    uint64_t bytesRead = 0;
+    for (int i = 0; i < fileCount; i++) {
+        bytesRead += fs.readFile("f" + std::to_string(i)).size();
+    }
+    double readSeconds = secondsSince(start);
+
+    uint64_t blocks = uint64_t(fileCount) * ((fileSize + g.blockSize - 1) / g.blockSize);
+    double mb = double(payload) / (1 << 20);
+    printf("%6u B x %9u blocks (%8.1f MB): alloc %10.0f blocks/s, write %8.1f MB/s, read %8.1f MB/s\n",
+        g.blockSize, g.blockCount, double(volumeBytes) / (1 << 20),
+        blocks / writeSeconds, mb / writeSeconds, double(bytesRead) / (1 << 20) / readSeconds);
+}
+
+// ѾԼ90%ɢĿնٲСļдʱķٶ
+static void benchNearlyFull(uint32_t blockCount) {
+    const uint32_t blockSize = 512;
+    FileSystem fs;
+    if (!fs.format(blockSize, blockCount)) {
+        return;
+    }
+
+    // ÿļ64飬д
+    const int blocksPerFile = 64;
+    std::string data(blocksPerFile * blockSize, 'x');
+    int fileCount = 0;
+    for (;; fileCount++) {
+        std::string name = "f" + std::to_string(fileCount);
+        if (!fs.createFile(name) || !fs.openFile(name) || !fs.writeFile(name, data)) {
+            fs.closeFile(name);
+            fs.deleteFile(name);
+            break;
+        }
+        fs.closeFile(name);
+    }
+
+    // ÿ10ļɾһпɢ
+    int deleted = 0;
+    for (int i = 0; i < fileCount; i += 10) {
+        fs.deleteFile("f" + std::to_string(i));
+        deleted++;
+    }
+
+    // дһնٶ
+    int rounds = deleted / 2;
+    auto start = Clock::now();
+    for (int i = 0; i < rounds; i++) {
+        std::string name = "g" + std::to_string(i);
+        fs.createFile(name);
+        fs.openFile(name);
+        fs.writeFile(name, data);
+        fs.closeFile(name);
+    }
+    double seconds = secondsSince(start);
+    printf("%9u blocks, ~90%% full: %10.0f blocks/s\n", blockCount, double(rounds) * blocksPerFile / seconds);
+}
+
+// MBļļд
+static void benchLargeFile(uint32_t blockSize, int megabytes) {
+    FileSystem fs;
+    uint32_t blockCount = static_cast<uint32_t>((uint64_t(megabytes) << 21) / blockSize);
+    if (!fs.format(blockSize, blockCount)) {
+        return;
+    }
+
+    std::string data(size_t(megabytes) << 20, 'x');
+    fs.createFile("big");
+    fs.openFile("big");
+
+    auto start = Clock::now();
+    fs.writeFile("big", data);
+    double writeSeconds = secondsSince(start);
+
+    const int reads = 8;
+    start = Clock::now();
+    uint64_t bytesRead = 0;
+    for (int i = 0; i < reads; i++) {
+        bytesRead += fs.readFile("big").size();
+    }
+    double readSeconds = secondsSince(start);
+
+    printf("%6u B blocks, %4d MB file: write %8.1f MB/s, read %8.1f MB/s\n", blockSize, megabytes,
+        megabytes / writeSeconds, double(bytesRead) / (1 << 20) / readSeconds);
+}
+
+// Ƭļϵӳ٣Աβ
+static void benchRandomRead(bool useIndex) {
+    const uint32_t blockSize = 512;
+    const int megabytes = 32;
+    FileSystem fs;
+    if (!fs.format(blockSize, static_cast<uint32_t>((megabytes * 2 + 8) << 11))) {
+        return;
+    }
+
+    // ļ׷ӣÿļÿһ鶼Գһ
+    fs.createFile("a");
+    fs.createFile("b");
+    int a = fs.open("a");
+    int b = fs.open("b");
+    std::string chunk(blockSize, 'x');
+    for (int i = 0; i < (megabytes << 11); i++) {
+        fs.write(a, chunk);
+        fs.write(b, chunk);
+    }
+
+    fs.setSeekIndex(useIndex);
+    std::mt19937 rng(1);
+    char buf[64];
+    const int reads = 20000;
+    auto start = Clock::now();
+    for (int i = 0; i < reads; i++) {
+        int offset = static_cast<int>(rng() % (uint32_t(megabytes) << 20));
+        fs.pread(a, offset, sizeof(buf), buf);
+    }
+    double seconds = secondsSince(start);
+    printf("%4d MB fragmented file, seek index %-3s: %10.2f us per random read\n",
+        megabytes, useIndex ? "on" : "off", seconds * 1e6 / reads);
+}
+
+// Ŀ¼´ļĴҡоɾ
+static void benchLargeDirectory(int entries) {
+    FileSystem fs;
+    if (!fs.format(512, static_cast<uint32_t>(entries + (1 << 12)))) {
+        return;
+    }
+    fs.mkdir("big");
+
+    std::vector<std::string> paths;
+    paths.reserve(entries);
+    for (int i = 0; i < entries; i++) {
+        paths.push_back("/big/f" + std::to_string(i));
+    }
+
+    auto start = Clock::now();
+    for (const std::string& path : paths) {
+        fs.createFile(path);
+    }
+    double createSeconds = secondsSince(start);
+
+    std::shuffle(paths.begin(), paths.end(), std::mt19937(1));
+    start = Clock::now();
+    for (const std::string& path : paths) {
+        fs.close(fs.open(path));
+    }
+    double lookupSeconds = secondsSince(start);
+
+    start = Clock::now();
+    size_t listed = fs.listDir("/big").size();
+    double listSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (const std::string& path : paths) {
+        fs.deleteFile(path);
+    }
+    double deleteSeconds = secondsSince(start);
+
+    printf("%7d entries (%zu listed): create %6.2f us, open %6.2f us, delete %6.2f us, listDir %7.1f ms\n",
+        entries, listed, createSeconds * 1e6 / entries, lookupSeconds * 1e6 / entries,
+        deleteSeconds * 1e6 / entries, listSeconds * 1e3);
+}
+
+// ļĿ¼Ԫռã桢غ͸ʽĺʱ
+static void benchMetadataTree(int files) {
+    const int perDir = 1000;
+    FileSystem fs;
+    if (!fs.format(512, static_cast<uint32_t>(files + (1 << 15)))) {
+        return;
+    }
+
+    auto start = Clock::now();
+    std::string dir;
+    for (int i = 0; i < files; i++) {
+        if (i % perDir == 0) {
+            dir = "/d" + std::to_string(i / perDir);
+            fs.mkdir(dir);
+        }
+        fs.createFile(dir + "/file" + std::to_string(i));
+    }
+    double createSeconds = secondsSince(start);
+    uint64_t metaBytes = fs.metadataMemory();
+
+    const char* image = "bench_tree.img";
+    start = Clock::now();
+    fs.saveToDisk(image);
+    double saveSeconds = secondsSince(start);
+
+    start = Clock::now();
+    fs.loadFromDisk(image);
+    double loadSeconds = secondsSince(start);
+    std::remove(image);
+
+    start = Clock::now();
+    fs.format();
+    double formatSeconds = secondsSince(start);
+
+    printf("%8d files: create %6.2f us each, metadata %6.1f MB, save %7.1f ms, load %7.1f ms, format %6.1f ms\n",
+        files, createSeconds * 1e6 / files, double(metaBytes) / (1 << 20),
+        saveSeconds * 1e3, loadSeconds * 1e3, formatSeconds * 1e3);
+}
+
+// һֱӳĶԱȣӳһζļŵҳ
+static void benchImageOpen(uint32_t blockSize, uint32_t blockCount) {
+    const char* image = "bench_volume.img";
+    {
+        FileSystem fs;
+        if (!fs.format(blockSize, blockCount)) {
+            return;
+        }
+        std::string chunk(1 << 20, 'x');
+        for (int i = 0; i < 64; i++) {
+            std::string name = "/f" + std::to_string(i);
+            fs.createFile(name);
+            int h = fs.open(name);
+            fs.write(h, chunk);
+            fs.close(h);
+        }
+        fs.saveToDisk(image);
+    }
+
+    double volumeMB = double(blockSize) * blockCount / (1 << 20);
+    {
+        FileSystem fs;
+        auto start = Clock::now();
+        fs.loadFromDisk(image);
+        printf("%6.0f MB image, loadFromDisk: %9.2f ms\n", volumeMB, secondsSince(start) * 1e3);
+    }
+    {
+        FileSystem fs;
+        auto start = Clock::now();
+        bool mapped = fs.mapImage(image);
+        double mapSeconds = secondsSince(start);
+
+        start = Clock::now();
+        int h = fs.open("/f17");
+        size_t bytes = fs.read(h, 1 << 20).size();
+        double readSeconds = secondsSince(start);
+        printf("%6.0f MB image, mapImage:     %9.2f ms%s, first 1 MB read %6.2f ms (%zu bytes)\n", volumeMB,
+            mapSeconds * 1e3, mapped ? "" : " (failed)", readSeconds * 1e3, bytes);
+    }
+    std::remove(image);
+}
+
+// ֻĶݺı棺ֻдĶĶԱ
+static void benchCheckpoint(uint32_t blockSize, uint32_t blockCount) {
+    const char* image = "bench_checkpoint.img";
+    const char* copy = "bench_checkpoint_full.img";
+    FileSystem fs;
+    if (!fs.format(blockSize, blockCount)) {
+        return;
+    }
+    std::string chunk(1 << 20, 'x');
+    for (int i = 0; i < 256; i++) {
+        std::string name = "/f" + std::to_string(i);
+        fs.createFile(name);
+        int h = fs.open(name);
+        fs.write(h, chunk);
+        fs.close(h);
+    }
+    fs.saveToDisk(image);
+
+    // СļļһСΣٽļ
+    std::mt19937 rng(3);
+    const int rounds = 5;
+    double fullSeconds = 0;
+    double changeSeconds = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < 16; i++) {
+            int h = fs.open("/f" + std::to_string(rng() % 256));
+            fs.pwrite(h, static_cast<int>(rng() % (1 << 20)), std::string(4096, 'y'));
+            fs.close(h);
+        }
+        fs.createFile("/new" + std::to_string(r));
+
+        auto start = Clock::now();
+        fs.saveToDisk(image);
+        changeSeconds += secondsSince(start);
+
+        start = Clock::now();
+        fs.saveToDisk(copy);
+        fullSeconds += secondsSince(start);
+        fs.saveToDisk(image);
+    }
+    printf("%6.0f MB volume, 16 small writes per save: full save %8.2f ms, incremental save %6.2f ms\n",
+        double(blockSize) * blockCount / (1 << 20), fullSeconds * 1e3 / rounds, changeSeconds * 1e3 / rounds);
+    std::remove(image);
+    std::remove(copy);
+}
+
+// ڴöľԪݳפݿ龭޵Ļ建д
+static void benchCachedImage(uint64_t volumeBytes, uint64_t cacheBytes) {
+    const char* image = "bench_cached.img";
+    const uint32_t blockSize = 4096;
+    FileSystem fs;
+    auto start = Clock::now();
+    if (!fs.createImage(image, blockSize, static_cast<uint32_t>(volumeBytes / blockSize), cacheBytes)) {
+        printf("cannot create %.0f GB image\n", double(volumeBytes) / (1 << 30));
+        return;
+    }
+    double createSeconds = secondsSince(start);
+
+    // 1 GB˳д룬Զڻ
+    const int files = 64;
+    const int fileBytes = 16 << 20;
+    std::string chunk(1 << 20, 'x');
+    start = Clock::now();
+    for (int i = 0; i < files; i++) {
+        std::string name = "/f" + std::to_string(i);
+        fs.createFile(name);
+        int h = fs.open(name);
+        for (int k = 0; k < (fileBytes >> 20); k++) {
+            fs.write(h, chunk);
+        }
+        fs.close(h);
+    }
+    fs.saveToDisk(image);
+    double writeSeconds = secondsSince(start);
+
+    // ȫݺֻһС
+    std::mt19937 rng(9);
+    char buf[4096];
+    const int reads = 50000;
+    for (int hotFiles : { files, 4 }) {
+        CacheStats before = fs.cacheStats();
+        start = Clock::now();
+        for (int i = 0; i < reads; i++) {
+            int h = fs.open("/f" + std::to_string(rng() % hotFiles));
+            fs.pread(h, static_cast<int>(rng() % (fileBytes - sizeof(buf))), sizeof(buf), buf);
+            fs.close(h);
+        }
+        double seconds = secondsSince(start);
+        CacheStats after = fs.cacheStats();
+        uint64_t hits = after.hits - before.hits;
+        uint64_t misses = after.misses - before.misses;
+        printf("  random 4 KB reads over %4d MB: %8.0f reads/s, hit rate %5.1f%%\n",
+            hotFiles * (fileBytes >> 20), reads / seconds, 100.0 * hits / (hits + misses));
+    }
+
+    CacheStats stats = fs.cacheStats();
+    printf("%5.0f GB volume, %4.0f MB cache: create %7.1f ms, write 1 GB %8.1f MB/s, %llu blocks written back\n",
+        double(volumeBytes) / (1 << 30), double(cacheBytes) / (1 << 20), createSeconds * 1e3,
+        1024 / writeSeconds, static_cast<unsigned long long>(stats.writebacks));
+    fs.format();
+    std::remove(image);
+}
+
+// ϰ1 MB˳ļ建ģÿζĿȫȱʧ
+// ÿI/O´һξ񣬱ȽϳύЧ
+static void benchImageStreaming(uint32_t blockSize) {
+    const char* image = "bench_stream.img";
+    const int files = 4;
+    const int fileBytes = 64 << 20;
+    const uint64_t cacheBytes = 16 << 20;
+    {
+        FileSystem fs;
+        if (!fs.createImage(image, blockSize, static_cast<uint32_t>((1ULL << 30) / blockSize), cacheBytes)) {
+            printf("cannot create image\n");
+            return;
+        }
+        std::string chunk(1 << 20, 'x');
+        for (int i = 0; i < files; i++) {
+            std::string name = "/f" + std::to_string(i);
+            fs.createFile(name);
+            int h = fs.open(name);
+            for (int k = 0; k < (fileBytes >> 20); k++) {
+                fs.write(h, chunk);
+            }
+            fs.close(h);
+        }
+        fs.saveToDisk(image);
+    }
+
+    std::vector<char> buf(1 << 20);
+    for (IoBackend backend : { IO_THREADS, IO_URING }) {
+        FileSystem fs;
+        if (!fs.openImage(image, cacheBytes, backend)) {
+            printf("  %5u B blocks: backend %d unavailable\n", blockSize, int(backend));
+            continue;
+        }
+        auto start = Clock::now();
+        for (int i = 0; i < files; i++) {
+            int h = fs.open("/f" + std::to_string(i));
+            for (int offset = 0; offset < fileBytes; offset += static_cast<int>(buf.size())) {
+                fs.pread(h, offset, static_cast<int>(buf.size()), buf.data());
+            }
+            fs.close(h);
+        }
+        double seconds = secondsSince(start);
+        printf("  %5u B blocks, %-11s: sequential 1 MB reads %8.1f MB/s\n",
+            blockSize, fs.ioEngine(), files * (fileBytes >> 20) / seconds);
+    }
+    std::remove(image);
+}
+
+// С˳д˳أԶСݣʱ
+// ˳Ԥǰд
+static void benchImageSequential(uint32_t blockSize, int ioBytes) {
+    const char* image = "bench_seq.img";
+    const int fileBytes = 256 << 20;
+    const uint64_t cacheBytes = 32 << 20;
+    std::string chunk(ioBytes, 's');
+    double writeSeconds;
+    {
+        FileSystem fs;
+        if (!fs.createImage(image, blockSize, static_cast<uint32_t>((1ULL << 30) / blockSize), cacheBytes)) {
+            printf("cannot create image\n");
+            return;
+        }
+        auto start = Clock::now();
+        fs.createFile("/s");
+        int h = fs.open("/s");
+        for (int offset = 0; offset < fileBytes; offset += ioBytes) {
+            fs.write(h, chunk);
+        }
+        fs.close(h);
+        fs.saveToDisk(image);
+        writeSeconds = secondsSince(start);
+    }
+
+    FileSystem fs;
+    fs.openImage(image, cacheBytes);
+    std::vector<char> buf(ioBytes);
+    auto start = Clock::now();
+    int h = fs.open("/s");
+    for (int offset = 0; offset < fileBytes; offset += ioBytes) {
+        fs.pread(h, offset, ioBytes, buf.data());
+    }
+    fs.close(h);
+    double readSeconds = secondsSince(start);
+    CacheStats stats = fs.cacheStats();
+    printf("  %5u B blocks, %6d B calls: write %8.1f MB/s, read %8.1f MB/s, hit rate %5.1f%%\n",
+        blockSize, ioBytes, (fileBytes >> 20) / writeSeconds, (fileBytes >> 20) / readSeconds,
+        100.0 * stats.hits / (stats.hits + stats.misses));
+    std::remove(image);
+}
+
+// 64λۼӵУֻͣһݵ
+static uint64_t checksum(const char* data, size_t len) {
+    uint64_t sum = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        sum += word;
+    }
+    for (; i < len; i++) {
+        sum += static_cast<uint8_t>(data[i]);
+    }
+    return sum;
+}
+
+// ļУͣreadFileƳһstringreadSpansֱӷʾڴ򻺴
+static void benchZeroCopyRead(bool cached) {
+    const char* image = "bench_spans.img";
+    const int files = 16;
+    const int fileBytes = 4 << 20;
+    const int rounds = 8;
+    FileSystem fs;
+    bool ok = cached ? fs.createImage(image, 4096, 1 << 16, 128 << 20) : fs.format(4096, 1 << 16);
+    if (!ok) {
+        printf("cannot create volume\n");
+        return;
+    }
+    std::string chunk(fileBytes, 'r');
+    for (int i = 0; i < files; i++) {
+        fs.createFile("/r" + std::to_string(i));
+        int h = fs.open("/r" + std::to_string(i));
+        fs.write(h, chunk);
+        fs.close(h);
+    }
+
+    uint64_t copySum = 0;
+    auto start = Clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < files; i++) {
+            std::string name = "/r" + std::to_string(i);
+            int h = fs.open(name);
+            std::string content = fs.readFile(name);
+            copySum += checksum(content.data(), content.size());
+            fs.close(h);
+        }
+    }
+    double copySeconds = secondsSince(start);
+
+    uint64_t spanSum = 0;
+    ReadLease lease;
+    start = Clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < files; i++) {
+            int h = fs.open("/r" + std::to_string(i));
+            fs.readSpans(h, 0, fileBytes, lease);
+            for (const DataSpan& span : lease.spans()) {
+                spanSum += checksum(span.data, span.len);
+            }
+            lease.release();
+            fs.close(h);
+        }
+    }
+    double spanSeconds = secondsSince(start);
+
+    double mb = double(rounds) * files * (fileBytes >> 20);
+    printf("  %-14s: readFile %8.1f MB/s, readSpans %8.1f MB/s%s\n", cached ? "cached image" : "memory volume",
+        mb / copySeconds, mb / spanSeconds, copySum == spanSum ? "" : " (checksum mismatch)");
+    if (cached) {
+        fs.format();
+        std::remove(image);
+    }
+}
+
+// ־ʽļÿ׷һ100ֽڵļ¼дappendFileWriterַʽ
+static void benchAppend() {
+    const std::string record(100, 'l');
+    FileSystem fs;
+    fs.format(512, 1 << 18);
+
+    // ԭֻܶȫݡ¼¼д
+    const int rewrites = 2000;
+    fs.createFile("/rewrite");
+    int h = fs.open("/rewrite");
+    auto start = Clock::now();
+    for (int i = 0; i < rewrites; i++) {
+        fs.writeFile("/rewrite", fs.readFile("/rewrite") + record);
+    }
+    double rewriteSeconds = secondsSince(start);
+    fs.close(h);
+
+    const int appends = 200000;
+    fs.createFile("/append");
+    h = fs.open("/append");
+    start = Clock::now();
+    for (int i = 0; i < appends; i++) {
+        fs.append(h, record);
+    }
+    double appendSeconds = secondsSince(start);
+    fs.close(h);
+
+    fs.createFile("/writer");
+    start = Clock::now();
+    {
+        FileWriter writer(fs, "/writer", 64 << 10);
+        for (int i = 0; i < appends; i++) {
+            writer.write(record);
+        }
+    }
+    double writerSeconds = secondsSince(start);
+
+    printf("  rewrite %8.0f records/s (%d records), append %8.0f records/s, FileWriter %8.0f records/s (%d records)\n",
+        rewrites / rewriteSeconds, rewrites, appends / appendSeconds, appends / writerSeconds, appends);
+}
+
+// ʮֽڵСļһ16384ľܷ¶ٸԼдĺʱ
+static void benchTinyFiles(uint32_t blockSize) {
+    const int files = 100000;
+    const std::string content(30, 't');
+    FileSystem fs;
+    fs.format(blockSize, 1 << 14);
+
+    int stored = 0;
+    std::string dir;
+    auto start = Clock::now();
+    for (int i = 0; i < files; i++) {
+        if (i % 1000 == 0) {
+            dir = "/d" + std::to_string(i / 1000);
+            fs.mkdir(dir);
+        }
+        std::string path = dir + "/f" + std::to_string(i);
+        if (!fs.createFile(path)) break;
+        int h = fs.open(path);
+        bool ok = fs.writeFile(path, content);
+        fs.close(h);
+        if (!ok) break;
+        stored++;
+    }
+    double seconds = secondsSince(start);
+
+    printf("%6u B blocks: %6d of %d 30-byte files fit in %5.1f MB, create+write %6.2f us each\n",
+        blockSize, stored, files, double(blockSize) * (1 << 14) / (1 << 20), seconds * 1e6 / std::max(stored, 1));
+}
+
+// ̸߳ԴԼļserializedΪʱÿεһȫ
+// ֮ǰߵ÷
+static void benchConcurrentRead(int threads, bool serialized) {
+    const int fileBytes = 8 << 20;
+    const int opsPerThread = 20000;
+    FileSystem fs;
+    if (!fs.format(4096, static_cast<uint32_t>((uint64_t(fileBytes) * threads >> 12) + 1024))) {
+        return;
+    }
+    std::string chunk(1 << 20, 'x');
+    for (int t = 0; t < threads; t++) {
+        std::string dir = "/t" + std::to_string(t);
+        fs.mkdir(dir);
+        fs.mkdir(dir + "/sub");
+        fs.createFile(dir + "/sub/data");
+        int h = fs.open(dir + "/sub/data");
+        for (int i = 0; i < (fileBytes >> 20); i++) {
+            fs.write(h, chunk);
+        }
+        fs.close(h);
+    }
+
+    std::mutex globalLock;
+    auto worker = [&](int t) {
+        std::string path = "/t" + std::to_string(t) + "/sub/data";
+        std::mt19937 rng(t);
+        char buf[4096];
+        for (int i = 0; i < opsPerThread; i += 16) {
+            // ÿ16ζ½һ·
+            std::unique_lock<std::mutex> lock(globalLock, std::defer_lock);
+            if (serialized) lock.lock();
+            int h = fs.open(path);
+            if (serialized) lock.unlock();
+            for (int k = 0; k < 16; k++) {
+                int offset = static_cast<int>(rng() % (fileBytes - sizeof(buf)));
+                if (serialized) lock.lock();
+                fs.pread(h, offset, sizeof(buf), buf);
+                if (serialized) lock.unlock();
+            }
+            if (serialized) lock.lock();
+            fs.close(h);
+        }
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    for (std::thread& th : pool) {
+        th.join();
+    }
+    double seconds = secondsSince(start);
+    printf("%2d threads, %-10s: %9.0f reads/s, %8.1f MB/s\n", threads, serialized ? "one mutex" : "fs locks",
+        threads * opsPerThread / seconds, threads * opsPerThread * 4096.0 / seconds / (1 << 20));
+}
+
+// ̸߳ԼĿ¼·дļķͷŶڲ
+static void benchConcurrentWrite(int threads) {
+    const int fileBytes = 256 << 10;
+    const int filesPerThread = 8;
+    const int rounds = 200;
+    FileSystem fs;
+    if (!fs.format(4096, 1 << 20)) {
+        return;
+    }
+    for (int t = 0; t < threads; t++) {
+        fs.mkdir("/w" + std::to_string(t));
+    }
+
+    auto worker = [&](int t) {
+        std::string dir = "/w" + std::to_string(t) + "/f";
+        std::string data(fileBytes, static_cast<char>('a' + t % 26));
+        for (int i = 0; i < filesPerThread; i++) {
+            fs.createFile(dir + std::to_string(i));
+        }
+        for (int r = 0; r < rounds; r++) {
+            std::string path = dir + std::to_string(r % filesPerThread);
+            int h = fs.open(path);
+            fs.writeFile(path, data);
+            fs.close(h);
+        }
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    for (std::thread& th : pool) {
+        th.join();
+    }
+    double seconds = secondsSince(start);
+    printf("%2d writer threads: %8.1f MB/s\n", threads, double(threads) * rounds * fileBytes / seconds / (1 << 20));
+}
+
+// ÿСҪ̣ÿβ󱣴棬밴ύ־ĶԱ
+static void benchDurableOps(uint32_t groupRecords) {
+    const char* image = "bench_durable.img";
+    FileSystem fs;
+    if (!fs.format(4096, 1 << 16)) {
+        return;
+    }
+    fs.saveToDisk(image);
+
+    const int ops = 2000;
+    auto start = Clock::now();
+    if (groupRecords == 0) {
+        for (int i = 0; i < ops; i++) {
+            fs.createFile("/s" + std::to_string(i));
+            fs.saveToDisk(image);
+        }
+    }
+    else {
+        fs.enableJournal(groupRecords);
+        for (int i = 0; i < ops; i++) {
+            fs.createFile("/j" + std::to_string(i));
+        }
+        fs.sync();
+    }
+    double seconds = secondsSince(start);
+    if (groupRecords == 0) {
+        printf("save after every op (no fsync): %9.0f ops/s\n", ops / seconds);
+    }
+    else {
+        printf("journal, group of %4u:         %9.0f ops/s\n", groupRecords, ops / seconds);
+    }
+    fs.disableJournal();
+    std::remove(image);
+}
+
+// ĺʱԱȣ֮һθдļҪ֮ԭд
+static void benchSnapshot(int files) {
+    const char* image = "bench_snapshot.img";
+    const char* clone = "bench_snapshot_clone.img";
+    const int fileBytes = 16 << 10;
+    FileSystem fs;
+    if (!fs.format(4096, static_cast<uint32_t>((uint64_t(fileBytes) * files >> 12) * 2 + 1024))) {
+        return;
+    }
+    std::string content(fileBytes, 's');
+    for (int i = 0; i < files; i++) {
+        std::string path = "/d" + std::to_string(i / 1000) + "/f" + std::to_string(i);
+        if (i % 1000 == 0) fs.mkdir("/d" + std::to_string(i / 1000));
+        fs.createFile(path);
+        int h = fs.open(path);
+        fs.writeFile(path, content);
+        fs.close(h);
+    }
+
+    auto start = Clock::now();
+    fs.saveToDisk(image);
+    double saveSeconds = secondsSince(start);
+
+    const int rounds = 100;
+    start = Clock::now();
+    for (int i = 0; i < rounds; i++) {
+        fs.snapshot();
+    }
+    double snapSeconds = secondsSince(start) / rounds;
+
+    std::unique_ptr<Snapshot> snap = fs.snapshot();
+    int h = fs.open("/d0/f0");
+    start = Clock::now();
+    fs.pwrite(h, 100, "x");
+    double firstWrite = secondsSince(start);
+    start = Clock::now();
+    fs.pwrite(h, 200, "y");
+    double secondWrite = secondsSince(start);
+    fs.close(h);
+
+    start = Clock::now();
+    snap->saveToDisk(clone);
+    double cloneSeconds = secondsSince(start);
+
+    printf("%6d x 16 KB files: saveToDisk %8.2f ms, snapshot %8.2f us, clone export %8.2f ms, "
+        "first write after snapshot %7.2f us, next %5.2f us\n",
+        files, saveSeconds * 1e3, snapSeconds * 1e6, cloneSeconds * 1e3, firstWrite * 1e6, secondWrite * 1e6);
+    snap.reset();
+    std::remove(image);
+    std::remove(clone);
+}
+
+// ȥֻļÿwholeʱһļ8ģ塢1/4ȫ0ͬ
+// ÿļǰ38ģ塢һͬظĿܶȴûͬļ
+// ȽϿȥʱռõĿ顢дʱָƵĿгȥʡı
+static void benchDedup(bool enabled, bool whole) {
+    const int files = 4000;
+    const int blockBytes = 4096;
+    const int fileBytes = 16 << 10;
+    FileSystem fs;
+    fs.format(blockBytes, 1 << 15);
+    fs.setDedup(enabled);
+
+    std::vector<std::string> templates;
+    for (int t = 0; t < 8; t++) {
+        templates.push_back(std::string(fileBytes, static_cast<char>('a' + t)));
+    }
+    const std::string zeros(fileBytes, '\0');
+    std::vector<std::string> contents(files);
+    std::unordered_set<uint64_t> distinctBlocks;
+    for (int i = 0; i < files; i++) {
+        std::string& data = contents[i];
+        if (whole && i % 4 == 0) {
+            data = zeros;
+        }
+        else if (whole && i % 4 != 1) {
+            data = templates[i % 8];
+        }
+        else {
+            // ͬļģǰ3һͬβ
+            data = whole ? std::string(fileBytes, 'u') : templates[i % 8];
+            size_t tail = whole ? 0 : fileBytes - blockBytes;
+            std::fill(data.begin() + tail, data.end(), 'u');
+            memcpy(&data[tail], &i, sizeof(i));
+        }
+        for (int off = 0; off < fileBytes; off += blockBytes) {
+            distinctBlocks.insert(ContentHash::compute(data.data() + off, blockBytes));
+        }
+    }
+
+    uint64_t freeBefore = fs.freeBlocks();
+    auto start = Clock::now();
+    for (int i = 0; i < files; i++) {
+        std::string path = "/f" + std::to_string(i);
+        fs.createFile(path);
+        int h = fs.open(path);
+        fs.writeFile(path, contents[i]);
+        fs.close(h);
+    }
+    double seconds = secondsSince(start);
+    uint64_t used = freeBefore - fs.freeBlocks();
+
+    DedupStats st = fs.dedupStats();
+    double ratio = st.bytesWritten > st.bytesShared ? double(st.bytesWritten) / (st.bytesWritten - st.bytesShared) : 1.0;
+    double blockRatio = double(files) * (fileBytes / blockBytes) / distinctBlocks.size();
+    printf("dedup %-3s %-13s: %6llu blocks used, write %6.2f us/file, whole-file ratio %5.2f (block-level would be %5.2f), "
+        "hash %5.2f us/file, verify %5.2f us/file\n",
+        enabled ? "on" : "off", whole ? "whole files" : "shared blocks", (unsigned long long)used, seconds * 1e6 / files,
+        ratio, blockRatio, st.hashNanos / 1e3 / std::max<uint64_t>(st.filesWritten, 1),
+        st.verifyNanos / 1e3 / std::max<uint64_t>(st.filesWritten, 1));
+}
+
+// ָƱ
+static void benchContentHash() {
+    std::vector<char> data(64 << 20);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 131 + (i >> 9));
+    }
+    uint64_t sink = 0;
+    const int rounds = 8;
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        sink += ContentHash::compute(data.data(), data.size());
+    }
+    double seconds = secondsSince(start);
+    printf("content hash: %6.2f GB/s (%016llx)\n", double(data.size()) * rounds / seconds / 1e9, (unsigned long long)sink);
+}
+
+// ־һıļдһ64 MBľѹʱܷ¶١4 KBٶ
+static void benchCompression(bool compressed) {
+    const int fileBytes = 256 << 10;
+    FileSystem fs;
+    fs.format(4096, 1 << 14);
+
+    std::mt19937 rng(11);
+    const char* words[] = { "GET", "POST", "/index.html", "/api/v1/items", "200", "404", "user=", "latency_ms=", "ok", "error" };
+    std::string text;
+    while (text.size() < fileBytes) {
+        text += "2026-10-16T12:" + std::to_string(rng() % 60) + ":" + std::to_string(rng() % 60) + " ";
+        for (int w = 0; w < 6; w++) {
+            text += words[rng() % 10];
+            text += std::to_string(rng() % 1000);
+            text += ' ';
+        }
+        text += '\n';
+    }
+    text.resize(fileBytes);
+
+    int stored = 0;
+    auto start = Clock::now();
+    for (;; stored++) {
+        std::string path = "/log" + std::to_string(stored);
+        if (!fs.createFile(path)) break;
+        fs.setCompressed(path, compressed);
+        int h = fs.open(path);
+        bool ok = fs.writeFile(path, text);
+        fs.close(h);
+        if (!ok) break;
+    }
+    double writeSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < stored; i++) {
+        std::string path = "/log" + std::to_string(i);
+        int h = fs.open(path);
+        fs.readFile(path);
+        fs.close(h);
+    }
+    double readSeconds = secondsSince(start);
+
+    const int reads = 20000;
+    std::vector<int> handles;
+    for (int i = 0; i < stored; i++) {
+        handles.push_back(fs.open("/log" + std::to_string(i)));
+    }
+    char buf[4096];
+    start = Clock::now();
+    for (int i = 0; i < reads; i++) {
+        fs.pread(handles[rng() % handles.size()], rng() % (fileBytes - sizeof(buf)), sizeof(buf), buf);
+    }
+    double randomSeconds = secondsSince(start);
+    for (int h : handles) {
+        fs.close(h);
+    }
+
+    printf("compression %-3s: %4d x 256 KB files fit, write %7.1f MB/s, read %7.1f MB/s, random 4 KB pread %6.2f us\n",
+        compressed ? "on" : "off", stored, double(fileBytes) * stored / writeSeconds / (1 << 20),
+        double(fileBytes) * stored / readSeconds / (1 << 20), randomSeconds * 1e6 / reads);
+}
+
+// 64ļ׷16 KBÿļɢ64Σ10 msһƬƬȽǰƬ̶Ⱥٶ
+static void benchDefragment() {
+    const char* image = "bench_defrag.img";
+    const int files = 64;
+    const int rounds = 64;
+    FileSystem fs;
+    if (!fs.createImage(image, 4096, 1 << 16, 16 << 20)) {
+        printf("cannot create %s\n", image);
+        return;
+    }
+    std::string piece(16 << 10, 'd');
+    for (int i = 0; i < files; i++) {
+        std::string path = "/f" + std::to_string(i);
+        fs.createFile(path);
+        fs.openFile(path);
+    }
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < files; i++) {
+            fs.appendFile("/f" + std::to_string(i), piece);
+        }
+    }
+
+    auto readAll = [&]() {
+        auto start = Clock::now();
+        for (int i = 0; i < files; i++) {
+            fs.readFile("/f" + std::to_string(i));
+        }
+        return double(piece.size()) * rounds * files / secondsSince(start) / (1 << 20);
+    };
+    FragmentationStats before = fs.fragmentation();
+    double readBefore = readAll();
+
+    int slices = 0;
+    double longest = 0;
+    uint64_t moved = 0;
+    auto start = Clock::now();
+    for (;;) {
+        auto sliceStart = Clock::now();
+        DefragProgress p = fs.defragment(10000);
+        longest = std::max(longest, secondsSince(sliceStart));
+        slices++;
+        moved += p.filesMoved;
+        if (p.passDone) break;
+    }
+    double defragSeconds = secondsSince(start);
+    FragmentationStats after = fs.fragmentation();
+    double readAfter = readAll();
+
+    printf("score %.3f -> %.3f (%llu -> %llu extents), %llu files moved in %d slices, longest %.2f ms, total %.1f ms; "
+        "read %.1f -> %.1f MB/s\n",
+        before.score, after.score, (unsigned long long)before.extents, (unsigned long long)after.extents,
+        (unsigned long long)moved, slices, longest * 1e3, defragSeconds * 1e3, readBefore, readAfter);
+    for (int i = 0; i < files; i++) {
+        fs.closeFile("/f" + std::to_string(i));
+    }
+    fs.format();
+    std::remove(image);
+}
+
+int main() {
+    const Geometry geometries[] = {
+        { 512, 1024 },
+        { 512, 1 << 16 },
+        { 512, 1 << 20 },
+        { 512, 1 << 22 },
+        { 4096, 1 << 18 },
+        { 4096, 1 << 20 },
+        { 65536, 1 << 14 },
+    };
+
+    printf("== volume growth ==\n");
+    checkFreshVolume(Geometry{ DEFAULT_BLOCK_SIZE, DEFAULT_BLOCK_COUNT });
+    checkFreshVolume(Geometry{ 4096, 1 << 12 });
+    for (const Geometry& g : geometries) {
+        benchVolumeGrowth(g);
+    }
+
+    printf("== allocation on a nearly full volume ==\n");
+    for (uint32_t blockCount : { 1u << 16, 1u << 20, 1u << 22 }) {
+        benchNearlyFull(blockCount);
+    }
+
+    printf("== large file ==\n");
+    for (uint32_t blockSize : { 512u, 4096u, 65536u }) {
+        benchLargeFile(blockSize, 64);
+    }
+
+    printf("== random read ==\n");
+    benchRandomRead(false);
+    benchRandomRead(true);
+
+    printf("== large directory ==\n");
+    for (int entries : { 10000, 100000, 500000 }) {
+        benchLargeDirectory(entries);
+    }
+
+    printf("== metadata tree ==\n");
+    for (int files : { 100000, 1000000 }) {
+        benchMetadataTree(files);
+    }
+
+    printf("== image open ==\n");
+    benchImageOpen(4096, 1 << 18);
+    benchImageOpen(4096, 1 << 20);
+
+    printf("== checkpoint ==\n");
+    benchCheckpoint(4096, 1 << 16);
+    benchCheckpoint(4096, 1 << 18);
+
+    printf("== cached image volume ==\n");
+    benchCachedImage(100ULL << 30, 256 << 20);
+
+    printf("== image streaming reads ==\n");
+    for (uint32_t blockSize : { 512u, 4096u }) {
+        benchImageStreaming(blockSize);
+    }
+
+    printf("== log appends ==\n");
+    benchAppend();
+
+    printf("== zero-copy reads ==\n");
+    benchZeroCopyRead(false);
+    benchZeroCopyRead(true);
+
+    printf("== image sequential access ==\n");
+    for (uint32_t blockSize : { 512u, 4096u }) {
+        for (int ioBytes : { 4096, 65536 }) {
+            benchImageSequential(blockSize, ioBytes);
+        }
+    }
+
+    printf("== tiny files ==\n");
+    for (uint32_t blockSize : { 512u, 4096u }) {
+        benchTinyFiles(blockSize);
+    }
+
+    printf("== concurrent read (%u hardware threads) ==\n", std::thread::hardware_concurrency());
+    for (int threads : { 1, 2, 4, 8 }) {
+        benchConcurrentRead(threads, true);
+        benchConcurrentRead(threads, false);
+    }
+
+    printf("== concurrent write ==\n");
+    for (int threads : { 1, 2, 4, 8, 16 }) {
+        benchConcurrentWrite(threads);
+    }
+
+    printf("== durable small ops ==\n");
+    for (uint32_t group : { 0u, 1u, 64u }) {
+        benchDurableOps(group);
+    }
+
+    printf("== snapshots ==\n");
+    for (int files : { 1000, 10000 }) {
+        benchSnapshot(files);
+    }
+
+    printf("== dedup ==\n");
+    benchContentHash();
+    for (bool whole : { true, false }) {
+        benchDedup(false, whole);
+        benchDedup(true, whole);
+    }
+
+    printf("== compression ==\n");
+    benchCompression(false);
+    benchCompression(true);
+
+    printf("== defragmentation ==\n");
+    benchDefragment();
+
+    if (checkFailures > 0) {
+        printf("%d check(s) FAILED\n", checkFailures);
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+// BlockAllocator.cpp
+#include "BlockAllocator.h"
+#include <algorithm>
+
+// ̰߳һηȺֵ飬֮һֱʹͬһ
+static std::atomic<uint32_t> threadCount(0);
+
+BlockAllocator::BlockAllocator() : groupCount(0), groupBlocks(1) {}
+
+uint32_t BlockAllocator::homeGroup() const {
+    thread_local uint32_t slot = threadCount++;
+    return slot % groupCount;
+}
+
+void BlockAllocator::attach(uint64_t* words, uint32_t blockCount) {
+    // ޣÿ64룬֤鲻λͼ
+    uint64_t perGroup = (uint64_t(blockCount) + MAX_ALLOC_GROUPS - 1) / MAX_ALLOC_GROUPS;
+    perGroup = std::max<uint64_t>((perGroup + 63) / 64 * 64, MIN_GROUP_BLOCKS);
+    groupBlocks = static_cast<uint32_t>(perGroup);
+    groupCount = static_cast<uint32_t>((uint64_t(blockCount) + groupBlocks - 1) / groupBlocks);
+    groups.reset(new Group[groupCount]);
+
+    for (uint32_t i = 0; i < groupCount; i++) {
+        Group& g = groups[i];
+        g.first = i * groupBlocks;
+        g.count = std::min(groupBlocks, blockCount - g.first);
+        g.bits.attach(words + g.first / 64, g.count);
+
+        // λͼ
+        g.extents.clear();
+        uint32_t runStart = 0;
+        uint32_t runCount = 0;
+        for (uint32_t b = 0; b < g.count; b++) {
+            if (g.bits.test(b)) {
+                g.extents.release(g.first + runStart, runCount);
+                runCount = 0;
+            }
+            else if (runCount++ == 0) {
+                runStart = b;
+            }
+        }
+        g.extents.release(g.first + runStart, runCount);
+        g.freeBlocks = g.extents.freeCount();
+    }
+}
+
+uint64_t BlockAllocator::freeCount() const {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < groupCount; i++) {
+        total += groups[i].freeBlocks.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// g.lock
+void BlockAllocator::reserveIn(Group& g, uint32_t start, uint32_t count) {
+    for (uint32_t b = start; b < start + count; b++) {
+        g.bits.set(b - g.first);
+    }
+    g.freeBlocks = g.extents.freeCount();
+}
+
+bool BlockAllocator::allocate(uint32_t blocks, std::vector<Extent>& out) {
+    size_t base = out.size();
+    uint32_t home = homeGroup();
+    for (uint32_t i = 0; i < groupCount && blocks > 0; i++) {
+        Group& g = groups[(home + i) % groupCount];
+        if (g.freeBlocks.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(g.lock);
+        Extent extent;
+        while (blocks > 0 && g.extents.allocate(blocks, extent)) {
+            reserveIn(g, extent.start, extent.count);
+            // ڵκϳһ
+            if (out.size() > base && out.back().start + out.back().count == extent.start) {
+                out.back().count += extent.count;
+            }
+            else {
+                out.push_back(extent);
+            }
+            blocks -= extent.count;
+        }
+    }
+    if (blocks == 0) {
+        return true;
+    }
+
+    // ߳ͬʱڷ䣬ռ䲻ˣ˻ȡĿ
+    for (size_t i = base; i < out.size(); i++) {
+        release(out[i].start, out[i].count);
+    }
+    out.resize(base);
+    return false;
+}
+
+bool BlockAllocator::allocateRun(uint32_t blocks, Extent& out) {
+    uint32_t home = homeGroup();
+    for (uint32_t i = 0; i < groupCount; i++) {
+        Group& g = groups[(home + i) % groupCount];
+        if (g.freeBlocks.load(std::memory_order_relaxed) < blocks) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(g.lock);
+        if (g.extents.longestRun() >= blocks && g.extents.allocate(blocks, out)) {
+            reserveIn(g, out.start, out.count);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t BlockAllocator::extendAt(uint32_t start, uint32_t maxCount) {
+    Group& g = groups[groupOf(start)];
+    std::lock_guard<std::mutex> lock(g.lock);
+    uint32_t count = std::min(maxCount, g.extents.runAt(start));
+    if (count > 0) {
+        g.extents.reserve(start, count);
+        reserveIn(g, start, count);
+    }
+    return count;
+}
+
+void BlockAllocator::release(uint32_t start, uint32_t count) {
+    while (count > 0) {
+        Group& g = groups[groupOf(start)];
+        uint32_t n = std::min(count, g.first + g.count - start);
+        {
+            std::lock_guard<std::mutex> lock(g.lock);
+            g.extents.release(start, n);
+            for (uint32_t b = start; b < start + n; b++) {
+                g.bits.clear(b - g.first);
+            }
+            g.freeBlocks = g.extents.freeCount();
+        }
+        start += n;
+        count -= n;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+// BlockAllocator.h
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "BlockBitmap.h"
+#include "FreeExtents.h"
+
+const uint32_t MAX_ALLOC_GROUPS = 64;           // 
+const uint32_t MIN_GROUP_BLOCKS = 16384;        // ÿٵĿ
+
+// 黮ֵĿп
+// ŵȷֳ飬Ŀ64ıռλͼеһ֣
+// ԼλͼΡͿм
+// ÿ̶̹߳һ䣬鲻ʱδȡ
+class BlockAllocator {
+private:
+    struct Group {
+        std::mutex lock;
+        uint32_t first;                      // ڵһ
+        uint32_t count;                      // ڿ
+        BlockBitmap bits;                    // λͼ
+        FreeExtents extents;                 // Ŀ
+        std::atomic<uint64_t> freeBlocks;    // пɶ
+    };
+
+    std::unique_ptr<Group[]> groups;
+    uint32_t groupCount;
+    uint32_t groupBlocks;                    // һÿĿ
+
+    uint32_t groupOf(uint32_t block) const { return block / groupBlocks; }
+    uint32_t homeGroup() const;
+    void reserveIn(Group& g, uint32_t start, uint32_t count);
+
+public:
+    BlockAllocator();
+
+    // 󶨾λͼ(1ʾ)ַ鲢λͼ
+    void attach(uint64_t* words, uint32_t blockCount);
+
+    // п֮ͣʱֻһֵ
+    uint64_t freeCount() const;
+
+    // blocks׷ӵoutĩβڰ䣻ռ䲻ʱκο
+    bool allocate(uint32_t blocks, std::vector<Extent>& out);
+    // һȡһblocks飬ûôĿжηfalse
+    bool allocateRun(uint32_t blocks, Extent& out);
+    // ռôstartʼеĿ飬maxCountռõĿ
+    uint32_t extendAt(uint32_t start, uint32_t maxCount);
+    // ͷһο飬Ż
+    void release(uint32_t start, uint32_t count);
+};
\ No newline at end of file
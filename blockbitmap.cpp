@@ -0,0 +1,16 @@
+// BlockBitmap.cpp
+#include "BlockBitmap.h"
+
+static const uint64_t FULL_WORD = ~0ULL;
+
+BlockBitmap::BlockBitmap() : words(nullptr), bitCount(0) {}
+
+void BlockBitmap::attach(uint64_t* newWords, uint32_t newBitCount) {
+    words = newWords;
+    bitCount = newBitCount;
+
+    // λΪãⱻȥ
+    if (bitCount % 64) {
+        words[bitCount / 64] |= FULL_WORD << (bitCount % 64);
+    }
+}
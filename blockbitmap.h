@@ -0,0 +1,21 @@
+// BlockBitmap.h
+#pragma once
+#include <cstdint>
+
+// λͼ(1ʾ)һΣ64λַ
+// ҿпɸĿֻλλ
+class BlockBitmap {
+private:
+    uint64_t* words;                          // λͼ
+    uint32_t bitCount;                        // Чλ(ܿ)
+
+public:
+    BlockBitmap();
+
+    // λͼĩβһֵλΪ
+    void attach(uint64_t* words, uint32_t bitCount);
+
+    bool test(uint32_t bit) const { return (words[bit / 64] >> (bit % 64)) & 1; }
+    void set(uint32_t bit) { words[bit / 64] |= 1ULL << (bit % 64); }       // Ϊ
+    void clear(uint32_t bit) { words[bit / 64] &= ~(1ULL << (bit % 64)); }  // Ϊ
+};
\ No newline at end of file
@@ -0,0 +1,510 @@
+// BlockDevice.cpp
+#include "BlockDevice.h"
+#include <cstring>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t NO_SLOT = 0xFFFFFFFF;
+static const uint64_t MAX_IO_BYTES = 1 << 20;     // Ŀϲһʱ
+
+// ԤдʱݴݵĻ壬ÿ߳һʹÿ·ȱҳ
+static char* stagingBuffer(uint64_t bytes) {
+    static thread_local std::vector<char> buffer;
+    if (buffer.size() < bytes) {
+        buffer.resize(bytes);
+    }
+    return buffer.data();
+}
+
+void MemoryDevice::read(uint64_t offset, char* buf, uint64_t len) {
+    memcpy(buf, base + offset, len);
+}
+
+void MemoryDevice::write(uint64_t offset, const char* data, uint64_t len) {
+    if (data) {
+        memcpy(base + offset, data, len);
+    }
+    else {
+        memset(base + offset, 0, len);
+    }
+}
+
+// ļͰƫƶдƽ̨ʵ
+#ifdef _WIN32
+
+FileDevice::FileDevice() : file(INVALID_HANDLE_VALUE), blockSize(0), lostWrites(false) {}
+
+bool FileDevice::openFile(const std::string& path) {
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    file = h;
+    return true;
+}
+
+void FileDevice::closeFile() {
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    file = INVALID_HANDLE_VALUE;
+}
+
+bool FileDevice::readBlock(uint32_t block, char* buf) {
+    OVERLAPPED ov = {};
+    uint64_t offset = uint64_t(block) * blockSize;
+    ov.Offset = DWORD(offset);
+    ov.OffsetHigh = DWORD(offset >> 32);
+    DWORD n = 0;
+    if (!ReadFile(file, buf, blockSize, &n, &ov)) {
+        n = 0;
+    }
+    // ļĩβ֮Ĳֵ0
+    memset(buf + n, 0, blockSize - n);
+    return true;
+}
+
+intptr_t FileDevice::nativeFile() const {
+    return reinterpret_cast<intptr_t>(file);
+}
+
+bool FileDevice::writeBlock(uint32_t block, const char* buf) {
+    OVERLAPPED ov = {};
+    uint64_t offset = uint64_t(block) * blockSize;
+    ov.Offset = DWORD(offset);
+    ov.OffsetHigh = DWORD(offset >> 32);
+    DWORD n = 0;
+    return WriteFile(file, buf, blockSize, &n, &ov) && n == blockSize;
+}
+
+#else
+
+FileDevice::FileDevice() : fd(-1), blockSize(0), lostWrites(false) {}
+
+bool FileDevice::openFile(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDWR);
+    return fd >= 0;
+}
+
+void FileDevice::closeFile() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+}
+
+bool FileDevice::readBlock(uint32_t block, char* buf) {
+    ssize_t n = pread(fd, buf, blockSize, static_cast<off_t>(uint64_t(block) * blockSize));
+    if (n < 0) n = 0;
+    // ļĩβ֮Ĳֵ0
+    memset(buf + n, 0, blockSize - n);
+    return true;
+}
+
+intptr_t FileDevice::nativeFile() const {
+    return fd;
+}
+
+bool FileDevice::writeBlock(uint32_t block, const char* buf) {
+    return pwrite(fd, buf, blockSize, static_cast<off_t>(uint64_t(block) * blockSize)) == ssize_t(blockSize);
+}
+
+#endif
+
+FileDevice::~FileDevice() {
+    close();
+}
+
+bool FileDevice::open(const std::string& path, uint32_t newBlockSize, uint64_t cacheBytes, IoBackend backend) {
+    close();
+    engine = IoEngine::create(backend, IO_QUEUE_DEPTH);
+    if (!engine) return false;
+    if (!openFile(path)) {
+        engine.reset();
+        return false;
+    }
+
+    // ƽָƬÿƬ16
+    blockSize = newBlockSize;
+    lostWrites = false;
+    shards.reset(new Shard[CACHE_SHARDS]);
+    for (uint32_t i = 0; i < CACHE_SHARDS; i++) {
+        Shard& s = shards[i];
+        s.capacity = static_cast<uint32_t>(std::max<uint64_t>(cacheBytes / blockSize / CACHE_SHARDS, 16));
+        s.blockOf.resize(s.capacity);
+        s.prev.resize(s.capacity);
+        s.next.resize(s.capacity);
+        s.dirty.assign(s.capacity, 0);
+        s.pins.assign(s.capacity, 0);
+        s.pinnedSlots = 0;
+        s.data.reset(new char[uint64_t(s.capacity) * blockSize]);
+        s.used = 0;
+        s.head = s.tail = NO_SLOT;
+        s.stats = CacheStats{};
+    }
+    return true;
+}
+
+// رǰдȫ
+void FileDevice::close() {
+    flush();
+    closeFile();
+    shards.reset();
+    engine.reset();
+}
+
+void FileDevice::unlinkSlot(Shard& s, uint32_t slot) {
+    uint32_t p = s.prev[slot];
+    uint32_t n = s.next[slot];
+    if (p != NO_SLOT) s.next[p] = n; else s.head = n;
+    if (n != NO_SLOT) s.prev[n] = p; else s.tail = p;
+}
+
+void FileDevice::pushFront(Shard& s, uint32_t slot) {
+    s.prev[slot] = NO_SLOT;
+    s.next[slot] = s.head;
+    if (s.head != NO_SLOT) s.prev[s.head] = slot; else s.tail = slot;
+    s.head = slot;
+}
+
+// ڻʱƵLRUͷݣ򷵻ؿ
+// s.lockͬ
+char* FileDevice::lookup(Shard& s, uint32_t block) {
+    auto found = s.slots.find(block);
+    if (found == s.slots.end()) return nullptr;
+
+    uint32_t slot = found->second;
+    if (s.head != slot) {
+        unlinkSlot(s, slot);
+        pushFront(s, slot);
+    }
+    return s.data.get() + uint64_t(slot) * blockSize;
+}
+
+// ڻеĿռһۣɵд
+// ʱ̭δûжסĿ飬дأдʧܼflush
+char* FileDevice::claim(Shard& s, uint32_t block) {
+    s.stats.misses++;
+    uint32_t slot;
+    if (s.used < s.capacity) {
+        slot = s.used++;
+    }
+    else {
+        slot = s.tail;
+        while (s.pins[slot]) {
+            slot = s.prev[slot];
+        }
+        unlinkSlot(s, slot);
+        if (s.dirty[slot]) {
+            if (writeBlock(s.blockOf[slot], s.data.get() + uint64_t(slot) * blockSize)) {
+                s.stats.writebacks++;
+            }
+            else {
+                lostWrites = true;
+            }
+            s.dirty[slot] = 0;
+        }
+        s.slots.erase(s.blockOf[slot]);
+    }
+
+    s.blockOf[slot] = block;
+    s.slots[block] = slot;
+    pushFront(s, slot);
+    return s.data.get() + uint64_t(slot) * blockSize;
+}
+
+// ȡڻеݣڻʱռһۣloadΪʱļ
+char* FileDevice::frame(Shard& s, uint32_t block, bool load) {
+    char* buf = lookup(s, block);
+    if (buf) {
+        s.stats.hits++;
+        return buf;
+    }
+    buf = claim(s, block);
+    if (load) {
+        readBlock(block, buf);
+    }
+    return buf;
+}
+
+// ѴļĿŽ棬outǿʱ[skip, skip+n)Ƹ
+// ļʱûг߳ѷŽĿܸ£ԻΪ׼
+void FileDevice::install(uint32_t block, const char* data, char* out, uint64_t skip, uint64_t n) {
+    Shard& s = shards[block % CACHE_SHARDS];
+    std::lock_guard<std::mutex> lock(s.lock);
+    char* cached = lookup(s, block);
+    if (cached) {
+        if (out) memcpy(out, cached + skip, n);
+        return;
+    }
+    memcpy(claim(s, block), data, blockSize);
+    if (out && out != data + skip) {
+        memcpy(out, data + skip, n);
+    }
+}
+
+// ѲڻеĿһ뻺棬ڵĺϳһ
+void FileDevice::fetch(const uint32_t* blocks, size_t count) {
+    std::vector<uint32_t> missing;
+    for (size_t i = 0; i < count; i++) {
+        Shard& s = shards[blocks[i] % CACHE_SHARDS];
+        std::lock_guard<std::mutex> lock(s.lock);
+        if (s.slots.find(blocks[i]) == s.slots.end()) {
+            missing.push_back(blocks[i]);
+        }
+    }
+    if (missing.empty()) return;
+
+    char* data = stagingBuffer(missing.size() * blockSize);
+    std::vector<IoRequest> requests;
+    for (size_t i = 0; i < missing.size(); i++) {
+        if (i > 0 && missing[i] == missing[i - 1] + 1 && requests.back().len + blockSize <= MAX_IO_BYTES) {
+            requests.back().len += blockSize;
+            continue;
+        }
+        requests.push_back(IoRequest{ uint64_t(missing[i]) * blockSize, data + i * blockSize, blockSize, false, 0 });
+    }
+    engine->run(nativeFile(), requests.data(), requests.size());
+    for (const IoRequest& r : requests) {
+        // ļĩβ֮Ĳֵ0
+        uint64_t got = static_cast<uint64_t>(std::max<int64_t>(r.result, 0));
+        if (got < r.len) {
+            memset(r.buf + got, 0, r.len - got);
+        }
+    }
+    for (size_t i = 0; i < missing.size(); i++) {
+        install(missing[i], data + i * blockSize, nullptr, 0, 0);
+    }
+}
+
+void FileDevice::read(uint64_t offset, char* buf, uint64_t len) {
+    if (len == 0) return;
+    uint32_t first = static_cast<uint32_t>(offset / blockSize);
+    uint32_t last = static_cast<uint32_t>((offset + len - 1) / blockSize);
+    if (first == last) {
+        Shard& s = shards[first % CACHE_SHARDS];
+        std::lock_guard<std::mutex> lock(s.lock);
+        memcpy(buf, frame(s, first, true) + offset % blockSize, len);
+        return;
+    }
+
+    // ȸƻеĿ飬ȱĿ
+    std::vector<uint32_t> missing;
+    for (uint64_t b = first; b <= last; b++) {
+        uint64_t start = std::max(offset, b * blockSize);
+        uint64_t end = std::min(offset + len, (b + 1) * blockSize);
+        Shard& s = shards[b % CACHE_SHARDS];
+        std::lock_guard<std::mutex> lock(s.lock);
+        char* cached = lookup(s, static_cast<uint32_t>(b));
+        if (cached) {
+            s.stats.hits++;
+            memcpy(buf + (start - offset), cached + (start - b * blockSize), end - start);
+        }
+        else {
+            missing.push_back(static_cast<uint32_t>(b));
+        }
+    }
+    if (missing.empty()) return;
+
+    // ȱֱӶߵĻ壬βĿʱ
+    // ļڴ϶ڵĿϳһһύ
+    std::unique_ptr<char[]> edges(new char[2 * uint64_t(blockSize)]);
+    auto target = [&](uint32_t b) -> char* {
+        uint64_t pos = uint64_t(b) * blockSize;
+        if (pos >= offset && pos + blockSize <= offset + len) return buf + (pos - offset);
+        return edges.get() + (b == first ? 0 : blockSize);
+    };
+    std::vector<IoRequest> requests;
+    for (uint32_t b : missing) {
+        uint64_t pos = uint64_t(b) * blockSize;
+        char* dst = target(b);
+        if (!requests.empty()) {
+            IoRequest& r = requests.back();
+            if (r.offset + r.len == pos && r.buf + r.len == dst && r.len + blockSize <= MAX_IO_BYTES) {
+                r.len += blockSize;
+                continue;
+            }
+        }
+        requests.push_back(IoRequest{ pos, dst, blockSize, false, 0 });
+    }
+    engine->run(nativeFile(), requests.data(), requests.size());
+    for (const IoRequest& r : requests) {
+        // ļĩβ֮Ĳֵ0
+        uint64_t got = static_cast<uint64_t>(std::max<int64_t>(r.result, 0));
+        if (got < r.len) {
+            memset(r.buf + got, 0, r.len - got);
+        }
+    }
+
+    for (uint32_t b : missing) {
+        uint64_t start = std::max(offset, uint64_t(b) * blockSize);
+        uint64_t end = std::min(offset + len, uint64_t(b + 1) * blockSize);
+        install(b, target(b), buf + (start - offset), start - uint64_t(b) * blockSize, end - start);
+    }
+}
+
+void FileDevice::write(uint64_t offset, const char* data, uint64_t len) {
+    // ֻһֵβҪȶԭݣһ
+    if (len > 0) {
+        uint32_t edges[2];
+        size_t count = 0;
+        uint32_t first = static_cast<uint32_t>(offset / blockSize);
+        uint32_t last = static_cast<uint32_t>((offset + len - 1) / blockSize);
+        if (offset % blockSize != 0) edges[count++] = first;
+        if ((offset + len) % blockSize != 0 && (count == 0 || last != first)) edges[count++] = last;
+        if (count > 1) fetch(edges, count);
+    }
+
+    while (len > 0) {
+        uint32_t block = static_cast<uint32_t>(offset / blockSize);
+        uint64_t skip = offset % blockSize;
+        uint64_t n = std::min<uint64_t>(len, blockSize - skip);
+
+        // 鸲ʱȶԭ
+        Shard& s = shards[block % CACHE_SHARDS];
+        {
+            std::lock_guard<std::mutex> lock(s.lock);
+            char* buf = frame(s, block, n != blockSize);
+            if (data) {
+                memcpy(buf + skip, data, n);
+            }
+            else {
+                memset(buf + skip, 0, n);
+            }
+            s.dirty[s.slots[block]] = 1;
+        }
+        if (data) data += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+// סȫƬ鰴Ϊһдύ
+bool FileDevice::flush() {
+    if (!shards) return true;
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    std::vector<std::pair<uint32_t, char*>> pending;   // (, )
+    for (uint32_t i = 0; i < CACHE_SHARDS; i++) {
+        Shard& s = shards[i];
+        locks.emplace_back(s.lock);
+        for (uint32_t slot = 0; slot < s.used; slot++) {
+            if (s.dirty[slot]) {
+                pending.push_back(std::make_pair(s.blockOf[slot], s.data.get() + uint64_t(slot) * blockSize));
+            }
+        }
+    }
+    if (pending.empty()) return !lostWrites;
+
+    std::sort(pending.begin(), pending.end());
+    std::vector<IoRequest> requests(pending.size());
+    for (size_t i = 0; i < pending.size(); i++) {
+        requests[i] = IoRequest{ uint64_t(pending[i].first) * blockSize, pending[i].second, blockSize, true, 0 };
+    }
+    engine->run(nativeFile(), requests.data(), requests.size());
+
+    bool ok = true;
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (requests[i].result != int64_t(blockSize)) {
+            ok = false;
+            continue;
+        }
+        Shard& s = shards[pending[i].first % CACHE_SHARDS];
+        s.dirty[s.slots[pending[i].first]] = 0;
+        s.stats.writebacks++;
+    }
+    return ok && !lostWrites;
+}
+
+void FileDevice::prefetch(const uint32_t* blocks, size_t count) {
+    if (count > 0) fetch(blocks, count);
+}
+
+// ȸƵĻڵĺϳһд
+// ֤߱дڼûб̸߳Щ
+void FileDevice::writeBack(const uint32_t* blocks, size_t count) {
+    std::vector<uint32_t> written;
+    char* data = stagingBuffer(count * blockSize);
+    std::vector<IoRequest> requests;
+    for (size_t i = 0; i < count; i++) {
+        Shard& s = shards[blocks[i] % CACHE_SHARDS];
+        std::lock_guard<std::mutex> lock(s.lock);
+        auto found = s.slots.find(blocks[i]);
+        if (found == s.slots.end() || !s.dirty[found->second]) continue;
+
+        char* dst = data + written.size() * blockSize;
+        memcpy(dst, s.data.get() + uint64_t(found->second) * blockSize, blockSize);
+        if (!written.empty() && written.back() + 1 == blocks[i] && requests.back().len + blockSize <= MAX_IO_BYTES) {
+            requests.back().len += blockSize;
+        }
+        else {
+            requests.push_back(IoRequest{ uint64_t(blocks[i]) * blockSize, dst, blockSize, true, 0 });
+        }
+        written.push_back(blocks[i]);
+    }
+    if (requests.empty()) return;
+    engine->run(nativeFile(), requests.data(), requests.size());
+
+    // дʧܵĿ鱣Ϊ̭࣬flushд
+    size_t next = 0;
+    for (const IoRequest& r : requests) {
+        uint32_t n = r.len / blockSize;
+        bool ok = r.result == int64_t(r.len);
+        for (uint32_t k = 0; k < n; k++, next++) {
+            if (!ok) continue;
+            Shard& s = shards[written[next] % CACHE_SHARDS];
+            std::lock_guard<std::mutex> lock(s.lock);
+            auto found = s.slots.find(written[next]);
+            if (found != s.slots.end() && s.dirty[found->second]) {
+                s.dirty[found->second] = 0;
+                s.stats.writebacks++;
+            }
+        }
+    }
+}
+
+const char* FileDevice::pin(uint32_t block) {
+    Shard& s = shards[block % CACHE_SHARDS];
+    std::lock_guard<std::mutex> lock(s.lock);
+    auto found = s.slots.find(block);
+    bool pinned = found != s.slots.end() && s.pins[found->second] > 0;
+    // һĲۿ̭
+    if (!pinned && s.pinnedSlots >= s.capacity / 2) {
+        return nullptr;
+    }
+
+    char* buf = frame(s, block, true);
+    uint32_t slot = s.slots[block];
+    if (s.pins[slot]++ == 0) {
+        s.pinnedSlots++;
+    }
+    return buf;
+}
+
+void FileDevice::unpin(uint32_t block) {
+    Shard& s = shards[block % CACHE_SHARDS];
+    std::lock_guard<std::mutex> lock(s.lock);
+    uint32_t slot = s.slots[block];
+    if (--s.pins[slot] == 0) {
+        s.pinnedSlots--;
+    }
+}
+
+CacheStats FileDevice::stats() {
+    CacheStats total = {};
+    if (!shards) return total;
+
+    for (uint32_t i = 0; i < CACHE_SHARDS; i++) {
+        Shard& s = shards[i];
+        std::lock_guard<std::mutex> lock(s.lock);
+        total.hits += s.stats.hits;
+        total.misses += s.stats.misses;
+        total.writebacks += s.stats.writebacks;
+        total.cachedBlocks += s.used;
+    }
+    return total;
+}
\ No newline at end of file
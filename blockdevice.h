@@ -0,0 +1,118 @@
+// BlockDevice.h
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "IoEngine.h"
+
+const uint64_t DEFAULT_CACHE_BYTES = 256ULL << 20;   // ĬϵĻ建С
+const uint32_t CACHE_SHARDS = 16;                    // Ƭȡģ
+const uint32_t IO_QUEUE_DEPTH = 64;                  // 첽I/Oͬʱ;
+
+// 建ļ
+struct CacheStats {
+    uint64_t hits;           // д()
+    uint64_t misses;         // δУļռһ
+    uint64_t writebacks;     // дļ
+    uint64_t cachedBlocks;   // ǰĿ
+};
+
+// ݿĴȡӿڣֽƫƶд
+// ͬ߳̿ͬʱʲͬͬһĻɵ߸
+class BlockDevice {
+public:
+    virtual ~BlockDevice() {}
+    virtual void read(uint64_t offset, char* buf, uint64_t len) = 0;
+    // dataΪʱд0
+    virtual void write(uint64_t offset, const char* data, uint64_t len) = 0;
+    // ѻ޸дش洢
+    virtual bool flush() { return true; }
+    // ˳дʱʾЩԤȶ棻ед
+    virtual void prefetch(const uint32_t*, size_t) {}
+    virtual void writeBack(const uint32_t*, size_t) {}
+};
+
+// ڴڴӳľ
+class MemoryDevice : public BlockDevice {
+private:
+    char* base;
+
+public:
+    explicit MemoryDevice(char* base) : base(base) {}
+    void read(uint64_t offset, char* buf, uint64_t len) override;
+    void write(uint64_t offset, const char* data, uint64_t len) override;
+};
+
+// ݿھļдС޵Ļ建д
+// 水ŷƬÿƬԼλLRṶʱдļflushдȫ
+// һζдʱȱĿϳһ󽻸첽I/O棬ͬʱ;
+// ԤǰдʱڵĿϳһ̭ʱдʧܵѾˣ˺flushһֱʧ
+class FileDevice : public BlockDevice {
+private:
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<uint32_t, uint32_t> slots;   //  -> ۺ
+        std::vector<uint32_t> blockOf;                  // ۺ -> 
+        std::vector<uint32_t> prev;                     // LRUheadΪʹ
+        std::vector<uint32_t> next;
+        std::vector<uint8_t> dirty;
+        std::vector<uint32_t> pins;                     // ۱סĴסĲ۲̭
+        uint32_t pinnedSlots;
+        std::unique_ptr<char[]> data;                   // ۵Ŀ
+        uint32_t capacity;
+        uint32_t used;
+        uint32_t head;
+        uint32_t tail;
+        CacheStats stats;
+    };
+
+#ifdef _WIN32
+    void* file;              // ļ
+#else
+    int fd;                  // ļ
+#endif
+    uint32_t blockSize;
+    std::unique_ptr<Shard[]> shards;
+    std::unique_ptr<IoEngine> engine;
+    std::atomic<bool> lostWrites;        // ̭ʱдʧܹ
+
+    bool openFile(const std::string& path);
+    void closeFile();
+    bool readBlock(uint32_t block, char* buf);
+    bool writeBlock(uint32_t block, const char* buf);
+    intptr_t nativeFile() const;
+    void unlinkSlot(Shard& s, uint32_t slot);
+    void pushFront(Shard& s, uint32_t slot);
+    char* lookup(Shard& s, uint32_t block);
+    char* claim(Shard& s, uint32_t block);
+    char* frame(Shard& s, uint32_t block, bool load);
+    void install(uint32_t block, const char* data, char* out, uint64_t skip, uint64_t n);
+    void fetch(const uint32_t* blocks, size_t count);
+
+public:
+    FileDevice();
+    ~FileDevice();
+    FileDevice(const FileDevice&) = delete;
+    FileDevice& operator=(const FileDevice&) = delete;
+
+    // 򿪾ļռcacheBytesֽڣbackendѡ첽I/Oʵ
+    bool open(const std::string& path, uint32_t blockSize, uint64_t cacheBytes, IoBackend backend = IO_AUTO);
+    void close();
+
+    void read(uint64_t offset, char* buf, uint64_t len) override;
+    void write(uint64_t offset, const char* data, uint64_t len) override;
+    bool flush() override;
+    void prefetch(const uint32_t* blocks, size_t count) override;
+    void writeBack(const uint32_t* blocks, size_t count) override;
+    // ѿ沢סݣⶤǰᱻ̭
+    // һƬﶤסĲѴһʱؿգɵ߸Ϊ
+    const char* pin(uint32_t block);
+    void unpin(uint32_t block);
+    CacheStats stats();
+    uint64_t cacheBytes() const { return uint64_t(shards[0].capacity) * CACHE_SHARDS * blockSize; }
+    const char* engineName() const { return engine ? engine->name() : ""; }
+};
\ No newline at end of file
@@ -0,0 +1,119 @@
+// ContentHash.cpp
+#include "ContentHash.h"
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CONTENT_HASH_SSE2 1
+#endif
+
+static const size_t STRIPE_BYTES = 64;                  // һ飬8·8ֽ
+static const size_t STRIPES_PER_ROUND = 16;             // ۻôɢһ
+static const uint64_t PRIME32_1 = 0x9E3779B1ULL;
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+
+// ·ԿÿְŴ8ֽȡ
+alignas(16) static const uint64_t KEYS[8 + STRIPES_PER_ROUND] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+    0xcb00c391bb52283cULL, 0xa32e531b8b65d088ULL, 0x4ef90da297486471ULL, 0xd8acdea946ef1938ULL,
+    0x3f349ce33f76faa8ULL, 0x1d4f0bc7c7bbdcf9ULL, 0x3159b4cd4be0518aULL, 0x647378d9c97e9fc8ULL,
+    0xc3ebd33483acc5eaULL, 0xeb6313faffa081c5ULL, 0x49daf0b751dd0d17ULL, 0x9e68d429265516d3ULL,
+    0xfca1477d58be162bULL, 0xce31d07ad1b8f88fULL, 0x280416958f3acb45ULL, 0x7e404bbbcafbd7afULL,
+};
+
+static inline uint64_t load64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#ifdef CONTENT_HASH_SSE2
+
+// ÿ·acc += һ·ԭ + (^Կ)ĵ32λ * 32λ
+static inline void accumulate(__m128i* acc, const char* p, const uint64_t* key) {
+    for (int i = 0; i < 4; i++) {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p) + i);
+        __m128i mixed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+        __m128i product = _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+    }
+}
+
+// ÿ·acc = (acc ^ acc >> 47 ^ Կ) * PRIME32_1
+static inline void scramble(__m128i* acc) {
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+    for (int i = 0; i < 4; i++) {
+        __m128i a = _mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(KEYS + STRIPES_PER_ROUND) + i));
+        __m128i low = _mm_mul_epu32(a, prime);
+        __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+    }
+}
+
+#else
+
+static inline void accumulate(uint64_t* acc, const char* p, const uint64_t* key) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t data = load64(p + i * 8);
+        uint64_t mixed = data ^ key[i];
+        acc[i ^ 1] += data;
+        acc[i] += (mixed & 0xFFFFFFFF) * (mixed >> 32);
+    }
+}
+
+static inline void scramble(uint64_t* acc) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t a = acc[i] ^ (acc[i] >> 47) ^ KEYS[STRIPES_PER_ROUND + i];
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#endif
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t ContentHash::compute(const char* data, size_t len) {
+#ifdef CONTENT_HASH_SSE2
+    __m128i acc[4];
+#else
+    uint64_t acc[8];
+#endif
+    alignas(16) uint64_t lanes[8] = {
+        PRIME32_1, PRIME64_1, PRIME64_2, 0x165667B19E3779F9ULL,
+        0x85EBCA77C2B2AE63ULL, 0x27D4EB2F165667C5ULL, 0x61C8864E7A143579ULL, PRIME32_1 ^ PRIME64_2,
+    };
+    memcpy(acc, lanes, sizeof(lanes));
+
+    // 鰴ۻĩβһĲ0һ飬ںϳʱ
+    const char* p = data;
+    size_t stripes = len / STRIPE_BYTES;
+    for (size_t s = 0; s < stripes; s++, p += STRIPE_BYTES) {
+        accumulate(acc, p, KEYS + s % STRIPES_PER_ROUND);
+        if (s % STRIPES_PER_ROUND == STRIPES_PER_ROUND - 1) {
+            scramble(acc);
+        }
+    }
+    if (len % STRIPE_BYTES) {
+        char last[STRIPE_BYTES] = {};
+        memcpy(last, p, len % STRIPE_BYTES);
+        accumulate(acc, last, KEYS + stripes % STRIPES_PER_ROUND);
+    }
+
+    memcpy(lanes, acc, sizeof(lanes));
+    uint64_t h = uint64_t(len) * PRIME64_1;
+    for (int i = 0; i < 8; i += 2) {
+        uint64_t a = lanes[i] ^ KEYS[i + 1];
+        uint64_t b = lanes[i + 1] ^ KEYS[i + 2];
+        h += (a & 0xFFFFFFFF) * (b >> 32) ^ (a >> 32) * (b & 0xFFFFFFFF) ^ a ^ (b << 7);
+        h = (h << 27 | h >> 37) * PRIME64_2;
+    }
+    return avalanche(h);
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+// ContentHash.h
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// ָƣҿͬݣкֽڱȽ
+// ÿ64ֽڷ8·˼ۻÿ16ɢһΣϳ64λ
+// x86-64SSE2һ·ƽ̨·㣬ͬ
+class ContentHash {
+public:
+    static uint64_t compute(const char* data, size_t len);
+};
\ No newline at end of file
@@ -0,0 +1,97 @@
+// DirIndex.cpp
+#include "DirIndex.h"
+#include "InodeTable.h"
+#include <functional>
+
+static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+DirIndex::DirIndex() : used(0) {}
+
+// ֵĹϣٻ븸Ŀ¼ţͬĿ¼µͬڲͬλ
+uint64_t DirIndex::hashKey(uint32_t dir, std::string_view name) {
+    return std::hash<std::string_view>()(name) ^ (uint64_t(dir) * 0x9E3779B97F4A7C15ull);
+}
+
+void DirIndex::clear() {
+    std::vector<uint64_t>().swap(slots);
+    used = 0;
+}
+
+// ̽(Ŀ¼, )ڵĲλ
+size_t DirIndex::findSlot(const InodeTable& table, uint32_t dir, std::string_view name, uint64_t hash) const {
+    if (slots.empty()) return NOT_FOUND;
+
+    size_t mask = slots.size() - 1;
+    uint64_t tag = hash & 0xFFFFFFFF;
+    for (size_t i = tag & mask;; i = (i + 1) & mask) {
+        uint64_t slot = slots[i];
+        if (slot == 0) return NOT_FOUND;
+        // ȱȹϣֵͬȥȽϸĿ¼
+        if ((slot >> 32) == tag) {
+            uint32_t ino = static_cast<uint32_t>((slot & 0xFFFFFFFF) - 1);
+            if (table[ino].parent == dir && table.name(ino) == name) {
+                return i;
+            }
+        }
+    }
+}
+
+void DirIndex::place(uint32_t ino, uint64_t hash) {
+    size_t mask = slots.size() - 1;
+    size_t i = (hash & 0xFFFFFFFF) & mask;
+    while (slots[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = ((hash & 0xFFFFFFFF) << 32) | (uint64_t(ino) + 1);
+}
+
+// װʳ3/4ʱλŹϣֵ¼
+void DirIndex::grow() {
+    std::vector<uint64_t> old;
+    old.swap(slots);
+    slots.assign(old.empty() ? 16 : old.size() * 2, 0);
+    for (uint64_t slot : old) {
+        if (slot != 0) {
+            place(static_cast<uint32_t>((slot & 0xFFFFFFFF) - 1), slot >> 32);
+        }
+    }
+}
+
+uint32_t DirIndex::find(const InodeTable& table, uint32_t dir, std::string_view name) const {
+    size_t i = findSlot(table, dir, name, hashKey(dir, name));
+    if (i == NOT_FOUND) return NO_INODE;
+    return static_cast<uint32_t>((slots[i] & 0xFFFFFFFF) - 1);
+}
+
+void DirIndex::insert(const InodeTable& table, uint32_t ino) {
+    if ((used + 1) * 4 > slots.size() * 3) {
+        grow();
+    }
+    place(ino, hashKey(table[ino].parent, table.name(ino)));
+    used++;
+}
+
+void DirIndex::remove(const InodeTable& table, uint32_t ino) {
+    if (slots.empty()) return;
+
+    // ̽inodeͬĲλرȽ
+    size_t mask = slots.size() - 1;
+    size_t i = hashKey(table[ino].parent, table.name(ino)) & 0xFFFFFFFF & mask;
+    while (slots[i] != 0 && (slots[i] & 0xFFFFFFFF) != uint64_t(ino) + 1) {
+        i = (i + 1) & mask;
+    }
+    if (slots[i] == 0) return;
+
+    // ɾ̽ϺĲλǰŲĹ
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; slots[j] != 0; j = (j + 1) & mask) {
+        size_t home = (slots[j] >> 32) & mask;
+        // home(hole, j]֮ʱjϵԪؿŲhole
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole] = 0;
+    used--;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+// DirIndex.h
+#pragma once
+#include <vector>
+#include <string_view>
+#include <cstdint>
+
+class InodeTable;
+
+// Ŀ¼
+// ȫһſѰַϣ(Ŀ¼, )ҵinodeţ
+// ֻϣֵinodeţֻinode
+class DirIndex {
+private:
+    std::vector<uint64_t> slots;     // 32λϣֵĵ32λ32λinode+10Ϊղ
+    size_t used;                     // òλ
+
+    static uint64_t hashKey(uint32_t dir, std::string_view name);
+    size_t findSlot(const InodeTable& table, uint32_t dir, std::string_view name, uint64_t hash) const;
+    void place(uint32_t ino, uint64_t hash);
+    void grow();
+
+public:
+    DirIndex();
+
+    size_t size() const { return used; }
+    void clear();
+    uint64_t memoryUsage() const { return slots.capacity() * sizeof(uint64_t); }
+
+    uint32_t find(const InodeTable& table, uint32_t dir, std::string_view name) const;
+    // inode֤߱ͬһĿ¼ûͬ
+    void insert(const InodeTable& table, uint32_t ino);
+    // ȥinodeڸĶ丸Ŀ¼֮ǰ
+    void remove(const InodeTable& table, uint32_t ino);
+};
\ No newline at end of file
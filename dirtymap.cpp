@@ -0,0 +1,35 @@
+// DirtyMap.cpp
+#include "DirtyMap.h"
+#include <algorithm>
+
+void DirtyMap::resize(uint32_t count) {
+    bits.resize((uint64_t(count) + 63) / 64, 0);
+}
+
+// ֻǹλɨλͼ
+void DirtyMap::clear() {
+    for (uint32_t i : items) {
+        bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+    items.clear();
+}
+
+void DirtyMap::markRange(uint32_t first, uint32_t last) {
+    for (uint64_t i = first; i <= last; i++) {
+        mark(static_cast<uint32_t>(i));
+    }
+}
+
+// ÿΪ(ʼ, )
+void DirtyMap::runs(std::vector<std::pair<uint32_t, uint32_t>>& out) {
+    out.clear();
+    std::sort(items.begin(), items.end());
+    for (uint32_t i : items) {
+        if (!out.empty() && out.back().first + out.back().second == i) {
+            out.back().second++;
+        }
+        else {
+            out.push_back(std::make_pair(i, 1u));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+// DirtyMap.h
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// ϣλͼȥأ˳±ţպͱֻй
+class DirtyMap {
+private:
+    std::vector<uint64_t> bits;       // ÿһλ1ʾѱ
+    std::vector<uint32_t> items;      // ѱǵı
+
+public:
+    // ÿɱǵıŷΧ[0, count)бǱ
+    void resize(uint32_t count);
+    void clear();
+
+    void mark(uint32_t i) {
+        uint64_t bit = uint64_t(1) << (i % 64);
+        if (!(bits[i / 64] & bit)) {
+            bits[i / 64] |= bit;
+            items.push_back(i);
+        }
+    }
+    void markRange(uint32_t first, uint32_t last);   // [first, last]
+
+    bool empty() const { return items.empty(); }
+    size_t size() const { return items.size(); }
+    // 򲢺ϲĶ
+    void runs(std::vector<std::pair<uint32_t, uint32_t>>& out);
+};
\ No newline at end of file
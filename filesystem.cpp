@@ -2,484 +2,2731 @@
 #include "FileSystem.h"
 #include <stack>
 #include <cstring>
-#include <sstream>
 #include <algorithm>
+#include <new>
+#include <climits>
+#include <cstdio>
+#include <sstream>
+#include <cstddef>
+#include <thread>
+#include <chrono>
+
+// ѹļݵıţͿչãظ
+static std::atomic<uint64_t> nextChunkToken(0);
+
+// ߳ѹһΣС˳ʱÿ½ѹ
+struct ChunkCache {
+    uint64_t token;          // ļݵıţ0ʾ
+    uint32_t chunk;          // κ
+    std::vector<char> data;
+};
+static thread_local ChunkCache chunkCache = { 0, 0, {} };
+
+FileSystem::FileSystem(uint32_t blockSize, uint32_t blockCount)
+    : blockSize(0), blockCount(0), memory(nullptr), fileDevice(nullptr), super(nullptr), bitmap(nullptr), fat(nullptr),
+      seekIndexEnabled(true), currentDir(ROOT_INODE), dedupEnabled(false), dedupCounters(), defragCursor(0) {
+    if (!validGeometry(blockSize, blockCount)) {
+        blockSize = DEFAULT_BLOCK_SIZE;
+        blockCount = DEFAULT_BLOCK_COUNT;
+    }
+    if (!setGeometry(blockSize, blockCount)) {
+        throw std::bad_alloc();
+    }
+}
 
-FileSystem::FileSystem() : memory(new char[BLOCK_COUNT * BLOCK_SIZE]) {
-    bitmap = reinterpret_cast<uint8_t*>(memory);
-    fat = reinterpret_cast<uint16_t*>(memory + BITMAP_SIZE);
+FileSystem::~FileSystem() {
+    releaseVolume();
+}
 
-    // ʼĿ¼
-    root.name = "/";
-    root.isDirectory = true;
-    root.startBlock = -1;  // Ŀ¼ʹݿ
-    root.size = 0;
-    currentDir = &root;
+// ֣[][λͼ][FAT] ηھף֮ݿ
+SuperBlock FileSystem::makeSuperBlock(uint32_t blockSize, uint32_t blockCount) {
+    SuperBlock sb = {};
+    sb.magic = FS_MAGIC;
+    sb.version = FS_VERSION;
+    sb.blockSize = blockSize;
+    sb.blockCount = blockCount;
+    sb.bitmapOffset = sizeof(SuperBlock);
+    sb.bitmapBytes = (uint64_t(blockCount) + 63) / 64 * 8;
+    sb.fatOffset = sb.bitmapOffset + sb.bitmapBytes;
+    uint64_t metaBytes = sb.fatOffset + uint64_t(blockCount) * sizeof(uint32_t);
+    sb.metaBlocks = static_cast<uint32_t>((metaBytes + blockSize - 1) / blockSize);
+    sb.inodeOffset = uint64_t(blockSize) * blockCount;
+    sb.inodeBytes = 0;
+    sb.freeBlocks = blockCount - sb.metaBlocks;
+    sb.heldChain = FAT_EOC;
+    return sb;
 }
 
-FileSystem::~FileSystem() {
-    delete[] memory;
+bool FileSystem::validGeometry(uint32_t blockSize, uint32_t blockCount) {
+    // С2
+    if (blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE || (blockSize & (blockSize - 1))) {
+        return false;
+    }
+    if (blockCount > MAX_BLOCK_COUNT) {
+        return false;
+    }
+    // Ԫ֮ٻҪһݿ
+    return blockCount > makeSuperBlock(blockSize, blockCount).metaBlocks;
+}
+
+bool FileSystem::setGeometry(uint32_t newBlockSize, uint32_t newBlockCount) {
+    // ȷ¿ռ䣬ʧʱԭ
+    char* newMemory = new (std::nothrow) char[uint64_t(newBlockSize) * newBlockCount];
+    if (!newMemory) return false;
+
+    releaseVolume();
+    memory = newMemory;
+    device.reset(new MemoryDevice(memory));
+    blockSize = newBlockSize;
+    blockCount = newBlockCount;
+
+    *reinterpret_cast<SuperBlock*>(memory) = makeSuperBlock(blockSize, blockCount);
+    attachVolume();
+    journal.close();
+    savedPath.clear();
+    dirtyBlocks.clear();
+    dirtyBlocks.resize(blockCount);
+
+    // ¿ռδʽǰλͼFATգԪڵĿΪãָļ
+    memset(bitmap, 0, super->bitmapBytes);
+    std::fill(fat, fat + blockCount, FAT_FREE);
+    attachAllocator();
+    return true;
+}
+
+// ׵ĳ鶨λλͼFAT
+void FileSystem::attachVolume() {
+    super = reinterpret_cast<SuperBlock*>(memory);
+    bitmap = reinterpret_cast<uint8_t*>(memory + super->bitmapOffset);
+    fat = reinterpret_cast<uint32_t*>(memory + super->fatOffset);
+}
+
+// λͼԪĿǱΪãָļ
+// ϴֻõĿʱãһ黹ĿпλͼͳƵĽˢ
+void FileSystem::attachAllocator() {
+    for (uint32_t i = 0; i < super->metaBlocks; i++) {
+        if (!(bitmap[i / 8] & (1 << (i % 8)))) {
+            bitmap[i / 8] |= (1 << (i % 8));
+            markBitmap(i, 1);
+        }
+    }
+    allocator.attach(reinterpret_cast<uint64_t*>(bitmap), blockCount);
+    if (super->heldChain != FAT_EOC) {
+        freeBlockChain(static_cast<int>(super->heldChain));
+        super->heldChain = FAT_EOC;
+        markBytes(0, sizeof(SuperBlock));
+    }
+    super->freeBlocks = allocator.freeCount();
+}
+
+// ͷžռ䣬ӳģʽ½ӳ䣬дҳϵͳдؾļͬдػе
+void FileSystem::releaseVolume() {
+    detachSnapshots();
+    device.reset();
+    fileDevice = nullptr;
+    if (image.isOpen()) {
+        image.close();
+    }
+    else {
+        delete[] memory;
+    }
+    imagePath.clear();
+    memory = nullptr;
+}
+
+// [offset, offset+len)ڵĿ飬ʱд
+void FileSystem::markBytes(uint64_t offset, uint64_t len) {
+    if (len == 0) return;
+    std::lock_guard<std::mutex> lock(dirtyLock);
+    dirtyBlocks.markRange(static_cast<uint32_t>(offset / blockSize),
+        static_cast<uint32_t>((offset + len - 1) / blockSize));
+}
+
+void FileSystem::markBitmap(uint32_t first, uint32_t count) {
+    markBytes(super->bitmapOffset + first / 8, (uint64_t(first) + count - 1) / 8 - first / 8 + 1);
+}
+
+void FileSystem::markFat(uint32_t first, uint32_t count) {
+    markBytes(super->fatOffset + uint64_t(first) * sizeof(uint32_t), uint64_t(count) * sizeof(uint32_t));
+}
+
+void FileSystem::touchInode(uint32_t ino) {
+    std::lock_guard<std::mutex> lock(dirtyLock);
+    inodes.touch(ino);
+}
+
+// blocks飬ٷֶΣռ䲻ʱκο
+bool FileSystem::allocateExtents(uint32_t blocks, std::vector<Extent>& extents) {
+    size_t first = extents.size();
+    if (!allocator.allocate(blocks, extents)) {
+        return false;
+    }
+    for (size_t i = first; i < extents.size(); i++) {
+        markBitmap(extents[i].start, extents[i].count);
+    }
+    return true;
+}
+
+// Ѹΰ˳򴮳һFAT
+void FileSystem::linkExtents(const std::vector<Extent>& extents) {
+    for (size_t i = 0; i < extents.size(); i++) {
+        const Extent& e = extents[i];
+        uint32_t last = e.start + e.count - 1;
+        for (uint32_t b = e.start; b < last; b++) {
+            fat[b] = b + 1;
+        }
+        fat[last] = (i + 1 < extents.size()) ? extents[i + 1].start : FAT_EOC;
+        markFat(e.start, e.count);
+    }
+}
+
+// 鰴ڵķ黹
+void FileSystem::freeBlockChain(int startBlock) {
+    uint32_t block = startBlock; // -1 תΪFAT_EOC
+    uint32_t runStart = 0;
+    uint32_t runCount = 0;
+    while (block != FAT_EOC && block < blockCount) {
+        uint32_t next = fat[block];
+        fat[block] = FAT_FREE;
+        markBitmap(block, 1);
+        markFat(block, 1);
+
+        // ڵĿϳһٻ
+        if (runCount > 0 && runStart + runCount == block) {
+            runCount++;
+        }
+        else {
+            allocator.release(runStart, runCount);
+            runStart = block;
+            runCount = 1;
+        }
+        block = next;
+    }
+    allocator.release(runStart, runCount);
+}
+
+// startFATȡblocksΣһFAT
+void FileSystem::chainExtents(uint32_t start, uint64_t blocks, std::vector<Extent>& extents) const {
+    uint32_t block = start;
+    for (uint64_t i = 0; i < blocks && block < blockCount; i++) {
+        if (!extents.empty() && extents.back().start + extents.back().count == block) {
+            extents.back().count++;
+        }
+        else {
+            extents.push_back(Extent{ block, 1 });
+        }
+        if (i + 1 < blocks) {
+            block = fat[block];
+        }
+    }
+}
+
+// ϵǷdataֽͬ
+bool FileSystem::chainEquals(uint32_t start, std::string_view data) {
+    FileMap map;
+    chainExtents(start, (data.size() + blockSize - 1) / blockSize, map.extents);
+    buildSeekIndex(map);
+    std::vector<char> chunk(std::min<uint64_t>(data.size(), 1 << 20));
+    FilePos pos = { 0, 0 };
+    for (uint64_t offset = 0; offset < data.size(); offset += chunk.size()) {
+        uint64_t n = std::min<uint64_t>(chunk.size(), data.size() - offset);
+        readData(map, offset, chunk.data(), n, pos);
+        if (memcmp(chunk.data(), data.data() + offset, n) != 0) return false;
+    }
+    return true;
+}
+
+// ָdataͬĿҵʱü1׿飬birthΪļԪûʱFAT_EOC
+uint32_t FileSystem::findDuplicate(uint64_t hash, uint64_t hashNanos, std::string_view data, uint32_t& birth) {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    dedupCounters.filesWritten++;
+    dedupCounters.bytesWritten += data.size();
+    dedupCounters.hashNanos += hashNanos;
+
+    auto found = dedupIndex.find(hash);
+    if (found == dedupIndex.end()) {
+        return FAT_EOC;
+    }
+    SharedChain& chain = sharedChains[found->second];
+    auto start = std::chrono::steady_clock::now();
+    bool same = chain.bytes == data.size() && chainEquals(found->second, data);
+    dedupCounters.verifyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!same) {
+        dedupCounters.collisions++;
+        return FAT_EOC;
+    }
+    dedupCounters.filesShared++;
+    dedupCounters.bytesShared += data.size();
+    chain.refs++;
+    birth = chain.birth;
+    return found->second;
+}
+
+// ǼдĿͬһָпʱ滻
+void FileSystem::indexChain(uint32_t start, uint64_t hash, uint64_t bytes, uint32_t birth) {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    sharedChains[start] = SharedChain{ hash, bytes, 1, birth };
+    dedupIndex.emplace(hash, start);
+}
+
+uint32_t FileSystem::chainRefs(uint32_t start) {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    auto found = sharedChains.find(start);
+    return found != sharedChains.end() ? found->second.refs : 1;
+}
+
+// ڹñʱƳļ¼
+bool FileSystem::chainEntry(uint32_t start, SharedChain& out) {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    auto found = sharedChains.find(start);
+    if (found == sharedChains.end()) {
+        return false;
+    }
+    out = found->second;
+    return true;
+}
+
+// һļøÿļʱtrueг
+bool FileSystem::releaseChainRef(uint32_t start) {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    auto found = sharedChains.find(start);
+    if (found == sharedChains.end()) {
+        return false;
+    }
+    if (--found->second.refs > 0) {
+        return true;
+    }
+    auto indexed = dedupIndex.find(found->second.hash);
+    if (indexed != dedupIndex.end() && indexed->second == start) {
+        dedupIndex.erase(indexed);
+    }
+    sharedChains.erase(found);
+    return false;
+}
+
+// ļԭظдļÿʱtrueȸһݣ
+// ռʱݽҪı䣬г
+bool FileSystem::chainShared(uint32_t ino) {
+    int start = inodes[ino].startBlock;
+    if (start < 0) return false;
+    std::lock_guard<std::mutex> lock(dedupLock);
+    auto found = sharedChains.find(static_cast<uint32_t>(start));
+    if (found == sharedChains.end()) {
+        return false;
+    }
+    if (found->second.refs > 1) {
+        return true;
+    }
+    auto indexed = dedupIndex.find(found->second.hash);
+    if (indexed != dedupIndex.end() && indexed->second == static_cast<uint32_t>(start)) {
+        dedupIndex.erase(indexed);
+    }
+    sharedChains.erase(found);
+    return false;
+}
+
+// ﲻüغ󰴸ļ׿õĿûָƣ֮ȥ
+void FileSystem::rebuildSharedChains() {
+    sharedChains.clear();
+    dedupIndex.clear();
+    std::unordered_map<uint32_t, uint32_t> refs;
+    for (uint32_t ino = 0; ino < inodes.size(); ino++) {
+        const Inode& node = inodes[ino];
+        if (node.inUse && !node.isDirectory && node.startBlock >= 0) {
+            refs[static_cast<uint32_t>(node.startBlock)]++;
+        }
+    }
+    for (const auto& r : refs) {
+        if (r.second > 1) {
+            sharedChains[r.first] = SharedChain{ 0, 0, r.second, inodes.currentEpoch() };
+        }
+    }
+}
+
+DedupStats FileSystem::dedupStats() {
+    std::lock_guard<std::mutex> lock(dedupLock);
+    return dedupCounters;
+}
+
+DefragProgress FileSystem::defragment(uint64_t budgetMicros) {
+    std::lock_guard<std::mutex> guard(defragLock);
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    DefragProgress progress = {};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(budgetMicros);
+    uint32_t first = defragCursor;
+    while (defragCursor < inodes.size()) {
+        // ÿһǰԤ㣬Ҳ㣻ÿεٿһԤСҲǰ
+        if (defragCursor != first && std::chrono::steady_clock::now() >= deadline) break;
+        uint32_t ino = defragCursor++;
+        if (!inodes[ino].inUse || inodes[ino].isDirectory || inodes[ino].startBlock < 0) continue;
+
+        // ڱдԼеļһһȵóԤ
+        std::unique_lock<std::shared_mutex> lock(fileLock(ino), std::try_to_lock);
+        if (!lock.owns_lock()) {
+            progress.filesSkipped++;
+            continue;
+        }
+        int start = inodes[ino].startBlock;
+        if (start < 0) continue;
+        progress.filesScanned++;
+        // ֻFATһ¶Ϊðļα
+        uint32_t blocks = 0;
+        uint32_t runs = 0;
+        chainRuns(static_cast<uint32_t>(start), blocks, runs);
+        if (runs <= 1) continue;
+
+        // õĿļҲøŸģ᣻ֻǼָģ갴׿µǼ
+        SharedChain entry = {};
+        bool indexed = chainEntry(static_cast<uint32_t>(start), entry);
+        if ((indexed && entry.refs > 1) || chainCaptured(ino) || !relocateChain(ino)) {
+            progress.filesSkipped++;
+        }
+        else {
+            progress.filesMoved++;
+            progress.blocksMoved += blocks;
+            if (indexed && entry.hash != 0) {
+                indexChain(static_cast<uint32_t>(inodes[ino].startBlock), entry.hash, entry.bytes, inodes[ino].chainEpoch);
+            }
+        }
+    }
+    if (defragCursor >= inodes.size()) {
+        progress.passDone = true;
+        defragCursor = 0;
+    }
+    return progress;
+}
+
+FragmentationStats FileSystem::fragmentation() {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    FragmentationStats stats = {};
+    for (uint32_t ino = 0; ino < inodes.size(); ino++) {
+        if (!inodes[ino].inUse || inodes[ino].isDirectory || inodes[ino].startBlock < 0) continue;
+        std::shared_lock<std::shared_mutex> lock(fileLock(ino));
+        if (inodes[ino].startBlock < 0) continue;
+        uint32_t blocks = 0;
+        uint32_t runs = 0;
+        chainRuns(static_cast<uint32_t>(inodes[ino].startBlock), blocks, runs);
+        stats.files++;
+        stats.blocks += blocks;
+        stats.extents += runs;
+        if (runs > 1) stats.fragmentedFiles++;
+    }
+    stats.score = stats.blocks > stats.files ? double(stats.extents - stats.files) / (stats.blocks - stats.files) : 0.0;
+    return stats;
+}
+
+// Ԫ[birth, death)ڽĿնøÿsnapLock
+bool FileSystem::heldBySnapshot(uint32_t birth, uint32_t death) const {
+    for (const Snapshot* snap : snapshots) {
+        if (snap->epoch >= birth && snap->epoch < death) return true;
+    }
+    return false;
+}
+
+// ļǰĿǷпãԭظдиļ
+bool FileSystem::chainCaptured(uint32_t ino) {
+    const Inode& file = inodes[ino];
+    if (file.startBlock < 0) return false;
+    std::lock_guard<std::mutex> lock(snapLock);
+    return heldBySnapshot(file.chainEpoch, inodes.currentEpoch());
+}
+
+// ѻĿӵsuper->heldChainĩβʱͷţsnapLock
+void FileSystem::holdChain(uint32_t start, uint32_t last, uint32_t birth) {
+    if (heldChains.empty()) {
+        super->heldChain = start;
+        markBytes(0, sizeof(SuperBlock));
+    }
+    else {
+        uint32_t tail = heldChains.back().last;
+        fat[tail] = start;
+        markFat(tail, 1);
+    }
+    heldChains.push_back(HeldChain{ start, last, birth, inodes.currentEpoch() });
+}
+
+// super->heldChainժµi黹snapLock
+void FileSystem::freeHeldChain(size_t i) {
+    const HeldChain& chain = heldChains[i];
+    uint32_t next = (i + 1 < heldChains.size()) ? heldChains[i + 1].start : FAT_EOC;
+    if (i == 0) {
+        super->heldChain = next;
+        markBytes(0, sizeof(SuperBlock));
+    }
+    else {
+        fat[heldChains[i - 1].last] = next;
+        markFat(heldChains[i - 1].last, 1);
+    }
+    fat[chain.last] = FAT_EOC;
+    freeBlockChain(static_cast<int>(chain.start));
+    heldChains.erase(heldChains.begin() + i);
+}
+
+// ļǰļڹʱֻüпʱգֱͷţ
+// inode¼αɵ߸
+void FileSystem::dropChain(uint32_t ino) {
+    const Inode& file = inodes[ino];
+    if (file.startBlock < 0 || releaseChainRef(static_cast<uint32_t>(file.startBlock))) return;
+    const FileMap& map = fileMap(ino);
+    uint32_t last = map.extents.back().start + map.extents.back().count - 1;
+
+    std::lock_guard<std::mutex> lock(snapLock);
+    if (heldBySnapshot(file.chainEpoch, inodes.currentEpoch())) {
+        holdChain(static_cast<uint32_t>(file.startBlock), last, file.chainEpoch);
+    }
+    else {
+        freeBlockChain(file.startBlock);
+    }
+}
+
+// дõļǰȰһݻϣռԭĿ飻
+// FATĺ̰¼ֻƸĶĿչಿ
+bool FileSystem::unshareChain(uint32_t ino, FilePos& pos) {
+    std::vector<Extent> extents;
+    if (!allocateExtents(fileBlocks(fileMap(ino)), extents)) {
+        return false;
+    }
+    switchChain(ino, extents, pos);
+    return true;
+}
+
+// ļݸƵ·extentsϣٻԭռļ
+void FileSystem::switchChain(uint32_t ino, std::vector<Extent>& extents, FilePos& pos) {
+    FileMap& map = fileMap(ino);
+    linkExtents(extents);
+
+    FileMap copy;
+    copy.extents.swap(extents);
+    buildSeekIndex(copy);
+    uint64_t size = storedBytes(inodes[ino]);
+    std::vector<char> chunk(std::min<uint64_t>(std::max<uint64_t>(size, 1), 1 << 20));
+    FilePos from = { 0, 0 };
+    FilePos to = { 0, 0 };
+    for (uint64_t offset = 0; offset < size; offset += chunk.size()) {
+        uint64_t n = std::min<uint64_t>(chunk.size(), size - offset);
+        readData(map, offset, chunk.data(), n, from);
+        writeData(copy, offset, chunk.data(), n, to);
+    }
+
+    dropChain(ino);
+    Inode& file = inodes.edit(ino);
+    file.startBlock = static_cast<int>(copy.extents[0].start);
+    file.chainEpoch = inodes.currentEpoch();
+    file.generation++;
+    touchInode(ino);
+    map.extents.swap(copy.extents);
+    map.seekIndex.swap(copy.seekIndex);
+    pos = FilePos{ 0, 0 };
+}
+
+// Ƭһļһη£Ҳٰ䣬
+// αԭٲƹȥ˻·Ŀ
+bool FileSystem::relocateChain(uint32_t ino) {
+    FileMap& map = fileMap(ino);
+    if (map.extents.size() <= 1) {
+        return false;
+    }
+    uint32_t blocks = fileBlocks(map);
+    std::vector<Extent> extents;
+    Extent run;
+    if (allocator.allocateRun(blocks, run)) {
+        markBitmap(run.start, run.count);
+        extents.push_back(run);
+    }
+    else if (!allocateExtents(blocks, extents)) {
+        return false;
+    }
+    if (extents.size() >= map.extents.size()) {
+        for (const Extent& e : extents) {
+            allocator.release(e.start, e.count);
+            markBitmap(e.start, e.count);
+        }
+        return false;
+    }
+    FilePos pos = { 0, 0 };
+    switchChain(ino, extents, pos);
+    return true;
+}
+
+// ļĩβ׷blocks飬Ƚһ֮
+bool FileSystem::extendFile(uint32_t ino, uint32_t blocks) {
+    if (blocks > allocator.freeCount()) {
+        return false;
+    }
+
+    FileMap& map = fileMap(ino);
+    std::vector<Extent> added;
+    if (!map.extents.empty()) {
+        uint32_t next = map.extents.back().start + map.extents.back().count;
+        uint32_t count = (next < blockCount) ? allocator.extendAt(next, blocks) : 0;
+        if (count > 0) {
+            markBitmap(next, count);
+            added.push_back(Extent{ next, count });
+            blocks -= count;
+        }
+    }
+    if (!allocateExtents(blocks, added)) {
+        // ߳õ˿ռ䣬˻ؽںռµĿ
+        for (const Extent& e : added) {
+            allocator.release(e.start, e.count);
+            markBitmap(e.start, e.count);
+        }
+        return false;
+    }
+    if (added.empty()) {
+        return true;
+    }
+    linkExtents(added);
+
+    // ӵԭβ
+    if (map.extents.empty()) {
+        Inode& file = inodes.edit(ino);
+        file.startBlock = static_cast<int>(added[0].start);
+        file.chainEpoch = inodes.currentEpoch();
+        touchInode(ino);
+    }
+    else {
+        Extent& tail = map.extents.back();
+        fat[tail.start + tail.count - 1] = added[0].start;
+        markFat(tail.start + tail.count - 1, 1);
+        if (tail.start + tail.count == added[0].start) {
+            tail.count += added[0].count;
+            added.erase(added.begin());
+        }
+    }
+
+    // ׷ӣؽ
+    uint64_t offset = uint64_t(fileBlocks(map)) * blockSize;
+    for (const Extent& e : added) {
+        map.seekIndex.push_back(offset);
+        offset += uint64_t(e.count) * blockSize;
+    }
+    map.extents.insert(map.extents.end(), added.begin(), added.end());
+    return true;
+}
+
+// ֻǰblocks飬Ŀͷţֻ֤߱ļ
+// αض̺µλÿѲڣһα汾
+void FileSystem::trimChain(uint32_t ino, uint32_t blocks, FilePos& pos) {
+    FileMap& map = fileMap(ino);
+    uint32_t kept = 0;
+    size_t i = 0;
+    while (i < map.extents.size() && kept + map.extents[i].count < blocks) {
+        kept += map.extents[i].count;
+        i++;
+    }
+    if (blocks == 0 || i >= map.extents.size()) return;
+    Extent& e = map.extents[i];
+    if (i + 1 == map.extents.size() && kept + e.count == blocks) return;
+
+    uint32_t last = e.start + (blocks - kept) - 1;
+    uint32_t next = fat[last];
+    fat[last] = FAT_EOC;
+    markFat(last, 1);
+    freeBlockChain(static_cast<int>(next));
+    e.count = blocks - kept;
+    map.extents.resize(i + 1);
+    if (map.seekIndex.size() > i + 1) {
+        map.seekIndex.resize(i + 1);
+    }
+
+    inodes.edit(ino).generation++;
+    touchInode(ino);
+    if (pos.extent > i) {
+        pos = FilePos{ 0, 0 };
+    }
+}
+
+// FATαиļ
+void FileSystem::chainRuns(uint32_t start, uint32_t& blocks, uint32_t& runs) const {
+    blocks = 0;
+    runs = 0;
+    uint32_t prev = FAT_EOC;
+    for (uint32_t block = start; block != FAT_EOC && block < blockCount; block = fat[block]) {
+        if (blocks == 0 || block != prev + 1) runs++;
+        blocks++;
+        prev = block;
+    }
+}
+
+uint32_t FileSystem::fileBlocks(const FileMap& map) const {
+    // вʱֱһ
+    if (!map.extents.empty() && map.seekIndex.size() == map.extents.size()) {
+        return static_cast<uint32_t>(map.seekIndex.back() / blockSize) + map.extents.back().count;
+    }
+
+    uint32_t blocks = 0;
+    for (const Extent& e : map.extents) {
+        blocks += e.count;
+    }
+    return blocks;
+}
+
+// βiǵiļеʼֽƫ
+// αһ׷ӣļʱֻģ߳̿ͬʱ
+void FileSystem::buildSeekIndex(FileMap& map) {
+    map.seekIndex.clear();
+    map.seekIndex.reserve(map.extents.size());
+    uint64_t offset = 0;
+    for (const Extent& e : map.extents) {
+        map.seekIndex.push_back(offset);
+        offset += uint64_t(e.count) * blockSize;
+    }
+}
+
+// λoffsetڵ
+void FileSystem::seekExtent(FileMap& map, uint64_t offset, FilePos& pos) {
+    size_t count = map.extents.size();
+
+    // ˳ʣoffsetposڻһ
+    if (pos.extent < count && pos.extentOffset <= offset) {
+        for (int step = 0; step < 2 && pos.extent < count; step++) {
+            uint64_t extentBytes = uint64_t(map.extents[pos.extent].count) * blockSize;
+            if (offset < pos.extentOffset + extentBytes) return;
+            pos.extentOffset += extentBytes;
+            pos.extent++;
+        }
+    }
+
+    // ʣڲ϶
+    if (seekIndexEnabled && count > 0) {
+        const std::vector<uint64_t>& index = map.seekIndex;
+        size_t i = std::upper_bound(index.begin(), index.end(), offset) - index.begin() - 1;
+        pos = FilePos{ i, index[i] };
+        return;
+    }
+
+    // ûʱֻܴӵһ
+    pos = FilePos{ 0, 0 };
+    while (pos.extent < count) {
+        uint64_t extentBytes = uint64_t(map.extents[pos.extent].count) * blockSize;
+        if (offset < pos.extentOffset + extentBytes) break;
+        pos.extentOffset += extentBytes;
+        pos.extent++;
+    }
+}
+
+// ļoffsetlenֽڣֻ漰Σposؽʱλ
+void FileSystem::readData(FileMap& map, uint64_t offset, char* buf, uint64_t len, FilePos& pos) {
+    seekExtent(map, offset, pos);
+    while (len > 0 && pos.extent < map.extents.size()) {
+        const Extent& e = map.extents[pos.extent];
+        uint64_t extentBytes = uint64_t(e.count) * blockSize;
+        uint64_t skip = offset - pos.extentOffset;
+        uint64_t n = std::min(len, extentBytes - skip);
+        device->read(uint64_t(e.start) * blockSize + skip, buf, n);
+        buf += n;
+        offset += n;
+        len -= n;
+        if (skip + n == extentBytes) {
+            pos.extentOffset += extentBytes;
+            pos.extent++;
+        }
+    }
+}
+
+// lenֽдļoffsetdataΪʱд0ǰ㹻
+void FileSystem::writeData(FileMap& map, uint64_t offset, const char* data, uint64_t len, FilePos& pos) {
+    seekExtent(map, offset, pos);
+    while (len > 0 && pos.extent < map.extents.size()) {
+        const Extent& e = map.extents[pos.extent];
+        uint64_t extentBytes = uint64_t(e.count) * blockSize;
+        uint64_t skip = offset - pos.extentOffset;
+        uint64_t n = std::min(len, extentBytes - skip);
+        device->write(uint64_t(e.start) * blockSize + skip, data, n);
+        if (data) data += n;
+        markBytes(uint64_t(e.start) * blockSize + skip, n);
+        offset += n;
+        len -= n;
+        if (skip + n == extentBytes) {
+            pos.extentOffset += extentBytes;
+            pos.extent++;
+        }
+    }
+}
+
+// ȡļαһηʱFATиļ
+FileMap& FileSystem::fileMap(uint32_t ino) {
+    std::lock_guard<std::mutex> lock(mapLock);
+    auto found = fileMaps.find(ino);
+    if (found != fileMaps.end()) {
+        return found->second;
+    }
+
+    FileMap& map = fileMaps[ino];
+    uint32_t block = inodes[ino].startBlock;
+    while (block != FAT_EOC && block < blockCount) {
+        if (!map.extents.empty()) {
+            Extent& last = map.extents.back();
+            if (last.start + last.count == block) {
+                last.count++;
+                block = fat[block];
+                continue;
+            }
+        }
+        map.extents.push_back(Extent{ block, 1 });
+        block = fat[block];
+    }
+    buildSeekIndex(map);
+    loadChunkTable(map, inodes[ino]);
+    return map;
+}
+
+// ·ɸĿ¼·һ
+void FileSystem::splitPath(std::string_view path, std::string_view& parentPath, std::string_view& name) {
+    size_t pos = path.find_last_of('/');
+    if (pos == std::string_view::npos) {
+        // ڵǰĿ¼
+        parentPath = std::string_view();
+        name = path;
+    }
+    else {
+        // "/name" ĸĿ¼ǸĿ¼
+        parentPath = (pos == 0) ? path.substr(0, 1) : path.substr(0, pos);
+        name = path.substr(pos + 1);
+    }
 }
 
-int FileSystem::allocateBlock() {
-    for (int i = 0; i < BLOCK_COUNT; i++) {
-        int byteIndex = i / 8;
-        int bitIndex = i % 8;
-        if (!(bitmap[byteIndex] & (1 << bitIndex))) {
-            bitmap[byteIndex] |= (1 << bitIndex); // Ϊ
-            fat[i] = 0xFFFF; // ļ
-            return i;
+// ·'/'𼶲ңʱַ
+bool FileSystem::findEntry(std::string_view path, uint32_t* ino, uint32_t* parent) {
+    uint32_t cur = currentDir;
+    if (!path.empty() && path[0] == '/') {
+        cur = ROOT_INODE; // ·Ӹʼ
+    }
+
+    size_t pos = 0;
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos) {
+            end = path.size();
+        }
+        std::string_view name = path.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (name.empty() || name == ".") {
+            // ǰĿ¼ı
+            continue;
+        }
+
+        if (name == "..") {
+            // Ŀ¼Ŀ¼ĸĿ¼Լ
+            if (inodes[cur].parent != NO_INODE) {
+                cur = inodes[cur].parent;
+            }
+            continue;
+        }
+
+        if (!inodes[cur].isDirectory) {
+            return false; // ·м䲻ļ
+        }
+
+        // Ŀ¼а(Ŀ¼, )ңһιϣ̽
+        uint32_t child = inodes.find(cur, name);
+        if (child == NO_INODE) {
+            return false; // δҵ
         }
+        cur = child;
+    }
+
+    if (ino) *ino = cur;
+    if (parent) *parent = inodes[cur].parent;
+    return true;
+}
+
+// Ŀ¼inodeһ
+void FileSystem::resetTree() {
+    inodes.reset();
+    fileMaps.clear();
+    sharedChains.clear();
+    dedupIndex.clear();
+    currentDir = ROOT_INODE;
+    closeAllHandles();
+}
+
+void FileSystem::format() {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    resetVolume();
+}
+
+void FileSystem::resetVolume() {
+    detachSnapshots();
+
+    // д
+    *super = makeSuperBlock(blockSize, blockCount);
+
+    // λͼ
+    memset(bitmap, 0, super->bitmapBytes);
+
+    // ʼFAT
+    for (uint32_t i = 0; i < blockCount; i++) {
+        fat[i] = FAT_FREE;
+    }
+
+    // ԪڵĿ鲻ܷļ
+    dirtyBlocks.clear();
+    attachAllocator();
+
+    // ؽĿ¼
+    resetTree();
+    journal.close();
+
+    // ǾļʱΪ׼Ԫд
+    if (!imagePath.empty()) {
+        savedPath = imagePath;
+        markBytes(0, uint64_t(super->metaBlocks) * blockSize);
+    }
+    else {
+        savedPath.clear();
+    }
+}
+
+bool FileSystem::format(uint32_t newBlockSize, uint32_t newBlockCount) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    if (!validGeometry(newBlockSize, newBlockCount)) {
+        return false;
+    }
+
+    if (newBlockSize != blockSize || newBlockCount != blockCount) {
+        if (!setGeometry(newBlockSize, newBlockCount)) {
+            return false;
+        }
+    }
+
+    resetVolume();
+    return true;
+}
+
+// У鳬飬밴βһ
+bool FileSystem::readSuperBlock(std::istream& is, SuperBlock& sb) {
+    is.read(reinterpret_cast<char*>(&sb), sizeof(sb));
+    if (!is || sb.magic != FS_MAGIC || sb.version != FS_VERSION ||
+        !validGeometry(sb.blockSize, sb.blockCount)) {
+        return false;
+    }
+    SuperBlock expected = makeSuperBlock(sb.blockSize, sb.blockCount);
+    return sb.bitmapOffset == expected.bitmapOffset && sb.bitmapBytes == expected.bitmapBytes &&
+        sb.fatOffset == expected.fatOffset && sb.inodeOffset == expected.inodeOffset;
+}
+
+// 㣺бϴαʱݣֻдظĶĿinode
+// ־ʱȰЩдݼǽ־̣ԭдһҲڼʱ
+bool FileSystem::saveChanges(const std::string& filename) {
+    bool mapped = image.isOpen() && filename == imagePath;
+    bool cached = fileDevice && filename == imagePath;
+    std::vector<ImageWrite> writes;
+    std::string inodeArea;
+    if (!inodes.saveChanges(writes, super->inodeOffset)) {
+        std::ostringstream os;
+        inodes.save(os);
+        inodeArea = os.str();
+        writes.push_back(ImageWrite{ super->inodeOffset, inodeArea.data(), inodeArea.size() });
+        inodes.markSaved();
+    }
+    super->inodeBytes = inodes.savedAreaBytes();
+    super->freeBlocks = allocator.freeCount();
+    uint32_t epoch = ++super->journalEpoch;
+    markBytes(0, sizeof(SuperBlock));
+
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    dirtyBlocks.runs(runs);
+    for (const auto& run : runs) {
+        uint64_t offset = uint64_t(run.first) * blockSize;
+        uint64_t bytes = uint64_t(run.second) * blockSize;
+        if (mapped) {
+            image.sync(offset, bytes);  // ĶѾļҳ
+        }
+        else if (cached) {
+            // ݿɻдأֻдԪ
+            if (run.first >= super->metaBlocks) continue;
+            bytes = uint64_t(std::min(run.second, super->metaBlocks - run.first)) * blockSize;
+            writes.push_back(ImageWrite{ offset, memory + offset, bytes });
+        }
+        else {
+            writes.push_back(ImageWrite{ offset, memory + offset, bytes });
+        }
+    }
+
+    bool ok = (!cached || device->flush()) &&
+        (!journal.isOpen() || journal.checkpoint(epoch, writes)) &&
+        Journal::writeAt(filename, writes, journal.isOpen()) &&
+        (!journal.isOpen() || journal.reset(epoch));
+    if (!ok) {
+        savedPath.clear();  // ״̬´
+        return false;
+    }
+
+    dirtyBlocks.clear();
+    return true;
+}
+
+void FileSystem::saveToDisk(const std::string& filename) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    saveVolume(filename);
+}
+
+void FileSystem::saveVolume(const std::string& filename) {
+    if (filename == savedPath && saveChanges(filename)) {
+        return;
+    }
+    // ӳԿ豸ʽ򿪵ľܽضд
+    if (filename == imagePath) {
+        return;
+    }
+
+    // дʱļٸʱԭ񱣳
+    std::string temp = filename + ".tmp";
+    std::ofstream ofs(temp, std::ios::binary);
+    if (!ofs) return;
+
+    // ԭд顢λͼFATݿ鶼ڹ̶ƫ
+    super->freeBlocks = allocator.freeCount();
+    uint32_t epoch = ++super->journalEpoch;
+    markBytes(0, sizeof(SuperBlock));
+    writeVolume(ofs);
+
+    // Ŀ¼ṹinodeһдٲϳinodeС
+    uint64_t inodeBytes = inodes.save(ofs);
+    ofs.seekp(offsetof(SuperBlock, inodeBytes));
+    ofs.write(reinterpret_cast<const char*>(&inodeBytes), sizeof(inodeBytes));
+    ofs.close();
+    if (!ofs || (journal.isOpen() && !Journal::syncFile(temp))) {
+        std::remove(temp.c_str());
+        return;
+    }
+#ifdef _WIN32
+    std::remove(filename.c_str());
+#endif
+    if (std::rename(temp.c_str(), filename.c_str()) != 0) {
+        std::remove(temp.c_str());
+        return;
+    }
+
+    // ھļʱʼǱ׼дļֻ㵼
+    if (imagePath.empty()) {
+        super->inodeBytes = inodeBytes;
+        inodes.markSaved();
+        savedPath = filename;
+        dirtyBlocks.clear();
+        // ־Ż¾
+        if (journal.isOpen()) {
+            journal.open(filename + ".journal", epoch);
+        }
+    }
+}
+
+// дݿ鲻ڴʱ豸ֶζ
+void FileSystem::writeVolume(std::ostream& os) {
+    if (!fileDevice) {
+        os.write(memory, volumeBytes());
+        return;
+    }
+
+    uint64_t offset = uint64_t(super->metaBlocks) * blockSize;
+    os.write(memory, offset);
+    std::vector<char> chunk(std::max<uint64_t>(blockSize, 1 << 20));
+    while (offset < volumeBytes()) {
+        uint64_t n = std::min<uint64_t>(chunk.size(), volumeBytes() - offset);
+        device->read(offset, chunk.data(), n);
+        os.write(chunk.data(), n);
+        offset += n;
+    }
+}
+
+// ־ļ㣺д񣬲жϵԭд
+void FileSystem::redoCheckpoint(const std::string& filename, const JournalScan& scan) {
+    std::vector<std::string> pages(scan.pages.size());
+    std::vector<ImageWrite> writes;
+    for (size_t i = 0; i < scan.pages.size(); i++) {
+        JournalReader reader(scan.pages[i].payload);
+        uint64_t offset;
+        if (reader.getU64(offset) && reader.getString(pages[i])) {
+            writes.push_back(ImageWrite{ offset, pages[i].data(), pages[i].size() });
+        }
+    }
+    Journal::writeAt(filename, writes, true);
+}
+
+void FileSystem::loadFromDisk(const std::string& filename) {
+    JournalScan scan;
+    {
+        std::unique_lock<std::shared_mutex> lock(treeLock);
+        if (!loadVolume(filename, scan)) {
+            return;
+        }
+    }
+
+    // ־뾵ͬһԪʱеĲЩԼ
+    replayJournal(scan.entries);
+
+    // һμǲ뾵
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    if (savedPath != filename) {
+        return;
+    }
+    std::string journalPath = filename + ".journal";
+    if (journal.open(journalPath, scan.epoch, scan.validBytes)) {
+        saveVolume(filename);
+    }
+    if (!journal.isOpen()) {
+        journal.open(journalPath, super->journalEpoch);
+    }
+}
+
+// 뾵񣬷trueʾ־лвҪ
+bool FileSystem::loadVolume(const std::string& filename, JournalScan& scan) {
+    detachSnapshots();
+    journal.close();
+
+    std::string journalPath = filename + ".journal";
+    bool journaled = Journal::scan(journalPath, scan);
+    if (journaled && scan.checkpointDone) {
+        redoCheckpoint(filename, scan);
+    }
+
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) return false;
+
+    // ȡУ鳬
+    SuperBlock sb;
+    if (!readSuperBlock(ifs, sb)) {
+        return false;
+    }
+
+    // βͬǰھļʱ·ռ
+    if (!imagePath.empty() || sb.blockSize != blockSize || sb.blockCount != blockCount) {
+        if (!setGeometry(sb.blockSize, sb.blockCount)) {
+            return false;
+        }
+    }
+
+    // һζ룬ʱһվ
+    ifs.seekg(0);
+    ifs.read(memory, volumeBytes());
+    if (!ifs) {
+        resetVolume();
+        return false;
+    }
+    attachVolume();
+    dirtyBlocks.clear();
+    attachAllocator();
+
+    // Ŀ¼ṹαȵļʱٽ
+    resetTree();
+    ifs.seekg(super->inodeOffset);
+    savedPath = inodes.load(ifs) ? filename : std::string();
+    rebuildSharedChains();
+    if (savedPath.empty() || !journaled) {
+        return false;
+    }
+    if (scan.epoch == super->journalEpoch && !scan.entries.empty()) {
+        return true;
+    }
+    journal.open(journalPath, super->journalEpoch);
+    return false;
+}
+
+// ־¼ִвڼ־ǹŵģʱܳtreeLock
+void FileSystem::replayJournal(const std::vector<JournalEntry>& entries) {
+    for (const JournalEntry& entry : entries) {
+        JournalReader reader(entry.payload);
+        std::string path, other;
+        uint64_t offset = 0;
+        if (!reader.getString(path)) break;
+
+        switch (entry.type) {
+        case JR_MKDIR:
+            mkdir(path);
+            break;
+        case JR_RMDIR:
+            rmdir(path);
+            break;
+        case JR_CREATE:
+            createFile(path);
+            break;
+        case JR_DELETE:
+            deleteFile(path);
+            break;
+        case JR_RENAME:
+            if (reader.getString(other)) rename(path, other);
+            break;
+        case JR_WRITE:
+            if (reader.getString(other)) {
+                int h = open(path);
+                writeFile(path, other);
+                close(h);
+            }
+            break;
+        case JR_PWRITE:
+            if (reader.getU64(offset) && reader.getString(other)) {
+                int h = open(path);
+                pwrite(h, static_cast<int>(offset), other);
+                close(h);
+            }
+            break;
+        case JR_COMPRESS:
+            if (reader.getU64(offset)) setCompressed(path, offset != 0);
+            break;
+        }
+    }
+}
+
+bool FileSystem::enableJournal(uint32_t groupRecords) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    if (savedPath.empty() || !imagePath.empty()) {
+        return false;
+    }
+    journal.setGroupRecords(groupRecords);
+    if (!journal.isOpen() && !journal.open(savedPath + ".journal", super->journalEpoch)) {
+        return false;
+    }
+
+    // һμ㣬֮־ľ
+    saveVolume(savedPath);
+    return journal.isOpen();
+}
+
+void FileSystem::disableJournal() {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    if (!journal.isOpen()) return;
+
+    std::string path = savedPath;
+    saveVolume(path);
+    journal.close();
+    std::remove((path + ".journal").c_str());
+}
+
+bool FileSystem::sync() {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    std::lock_guard<std::mutex> lock(journalLock);
+    return journal.isOpen() && journal.commit();
+}
+
+// inodeľ·־·¼
+std::string FileSystem::pathOf(uint32_t ino) const {
+    std::vector<std::string_view> parts;
+    for (; ino != ROOT_INODE; ino = inodes[ino].parent) {
+        parts.push_back(inodes.name(ino));
+    }
+    if (parts.empty()) return "/";
+
+    std::string path;
+    for (size_t i = parts.size(); i-- > 0;) {
+        path += '/';
+        path += parts[i];
+    }
+    return path;
+}
+
+// һֻ·Ĳ¼ûд־ʱfalse
+bool FileSystem::logPath(uint8_t type, uint32_t ino) {
+    std::lock_guard<std::mutex> lock(journalLock);
+    journal.begin(type);
+    journal.putString(pathOf(ino));
+    return journal.end();
+}
+
+bool FileSystem::mapImage(const std::string& filename) {
+    // δ־ʱȼһΣɼع־дؾ
+    JournalScan scan;
+    if (Journal::scan(filename + ".journal", scan) && (scan.checkpointDone || !scan.entries.empty())) {
+        loadFromDisk(filename);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    journal.close();
+
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) return false;
+
+    SuperBlock sb;
+    if (!readSuperBlock(ifs, sb)) {
+        return false;
+    }
+
+    // Ȱinode±ʱԭӰ
+    InodeTable loaded;
+    ifs.seekg(sb.inodeOffset);
+    if (!loaded.load(ifs)) {
+        return false;
+    }
+
+    MappedFile mapped;
+    if (!mapped.open(filename, uint64_t(sb.blockSize) * sb.blockCount)) {
+        return false;
+    }
+
+    // ӳľֻλͼFATݿõʱٵ
+    releaseVolume();
+    image.swap(mapped);
+    imagePath = filename;
+    memory = image.data();
+    device.reset(new MemoryDevice(memory));
+    blockSize = sb.blockSize;
+    blockCount = sb.blockCount;
+    attachVolume();
+    savedPath = filename;
+    dirtyBlocks.clear();
+    dirtyBlocks.resize(blockCount);
+    attachAllocator();
+
+    resetTree();
+    inodes = std::move(loaded);
+    rebuildSharedChains();
+    return true;
+}
+
+bool FileSystem::openImage(const std::string& filename, uint64_t cacheBytes, IoBackend backend) {
+    // 豸ʽ־־ļֱӲдĲ򿪺
+    std::string journalPath = filename + ".journal";
+    JournalScan scan;
+    bool journaled = Journal::scan(journalPath, scan);
+    {
+        std::unique_lock<std::shared_mutex> lock(treeLock);
+        journal.close();
+        if (journaled && scan.checkpointDone) {
+            redoCheckpoint(filename, scan);
+        }
+
+        std::ifstream ifs(filename, std::ios::binary);
+        if (!ifs) return false;
+
+        SuperBlock sb;
+        if (!readSuperBlock(ifs, sb)) {
+            return false;
+        }
+
+        // Ԫinodeڴ棬ݿļ
+        uint64_t metaBytes = uint64_t(sb.metaBlocks) * sb.blockSize;
+        std::unique_ptr<char[]> meta(new (std::nothrow) char[metaBytes]);
+        if (!meta) return false;
+        ifs.seekg(0);
+        ifs.read(meta.get(), metaBytes);
+        InodeTable loaded;
+        ifs.seekg(sb.inodeOffset);
+        if (!ifs || !loaded.load(ifs)) {
+            return false;
+        }
+
+        std::unique_ptr<FileDevice> opened(new FileDevice());
+        if (!opened->open(filename, sb.blockSize, cacheBytes, backend)) {
+            return false;
+        }
+
+        releaseVolume();
+        memory = meta.release();
+        fileDevice = opened.get();
+        device.reset(opened.release());
+        imagePath = filename;
+        blockSize = sb.blockSize;
+        blockCount = sb.blockCount;
+        attachVolume();
+        savedPath = filename;
+        dirtyBlocks.clear();
+        dirtyBlocks.resize(blockCount);
+        attachAllocator();
+
+        resetTree();
+        inodes = std::move(loaded);
+        rebuildSharedChains();
+        if (!journaled || scan.epoch != super->journalEpoch || scan.entries.empty()) {
+            if (journaled) std::remove(journalPath.c_str());
+            return true;
+        }
+    }
+
+    replayJournal(scan.entries);
+    saveToDisk(filename);
+    std::remove(journalPath.c_str());
+    return true;
+}
+
+bool FileSystem::createImage(const std::string& filename, uint32_t newBlockSize, uint32_t newBlockCount,
+    uint64_t cacheBytes, IoBackend backend) {
+    if (!validGeometry(newBlockSize, newBlockCount)) {
+        return false;
+    }
+
+    // ֻڴﹹԪ顢λͼFATԪݿΪ
+    SuperBlock sb = makeSuperBlock(newBlockSize, newBlockCount);
+    uint64_t metaBytes = uint64_t(sb.metaBlocks) * newBlockSize;
+    std::unique_ptr<char[]> meta(new (std::nothrow) char[metaBytes]());
+    if (!meta) return false;
+    memcpy(meta.get(), &sb, sizeof(sb));
+    uint8_t* bits = reinterpret_cast<uint8_t*>(meta.get() + sb.bitmapOffset);
+    for (uint32_t i = 0; i < sb.metaBlocks; i++) {
+        bits[i / 8] |= (1 << (i % 8));
+    }
+
+    // дļϵͳ֧ʱΪϡļֻиĿ¼inode
+    {
+        std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+        if (!ofs) return false;
+        ofs.write(meta.get(), metaBytes);
+        InodeTable empty;
+        ofs.seekp(sb.inodeOffset);
+        uint64_t inodeBytes = empty.save(ofs);
+        ofs.seekp(offsetof(SuperBlock, inodeBytes));
+        ofs.write(reinterpret_cast<const char*>(&inodeBytes), sizeof(inodeBytes));
+        if (!ofs) return false;
+    }
+    std::remove((filename + ".journal").c_str());
+    return openImage(filename, cacheBytes, backend);
+}
+
+CacheStats FileSystem::cacheStats() {
+    std::shared_lock<std::shared_mutex> lock(treeLock);
+    return fileDevice ? fileDevice->stats() : CacheStats{};
+}
+
+// Ŀ¼ʵ
+bool FileSystem::mkdir(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+
+    // Ŀ¼͸Ŀ¼·
+    std::string_view parentPath, dirName;
+    splitPath(path, parentPath, dirName);
+
+    // ҸĿ¼
+    uint32_t parent = NO_INODE;
+    if (!findEntry(parentPath, &parent, nullptr) || !inodes[parent].isDirectory) {
+        return false;
+    }
+
+    // Ŀ¼ͬѴʱʧܣĿ¼ʹݿ
+    uint32_t dir = inodes.create(parent, dirName, true);
+    if (dir == NO_INODE) {
+        return false;
+    }
+    return !journal.isOpen() || logPath(JR_MKDIR, dir);
+}
+
+bool FileSystem::rmdir(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    uint32_t dir = NO_INODE;
+    uint32_t parent = NO_INODE;
+
+    if (!findEntry(path, &dir, &parent) || !inodes[dir].isDirectory) {
+        return false;
+    }
+
+    // Ŀ¼ǷΪ
+    if (inodes[dir].firstChild != NO_INODE) {
+        return false;
+    }
+
+    // ӸĿ¼ɾ
+    bool logged = true;
+    if (parent != NO_INODE) {
+        logged = !journal.isOpen() || logPath(JR_RMDIR, dir);
+        if (currentDir == dir) {
+            currentDir = parent;
+        }
+        inodes.remove(dir);
+    }
+    return logged;
+}
+
+std::vector<std::string> FileSystem::listDir(const std::string& path) {
+    std::shared_lock<std::shared_mutex> lock(treeLock);
+    std::vector<std::string> result;
+    uint32_t target = currentDir;
+
+    if (!path.empty()) {
+        if (!findEntry(path, &target, nullptr) || !inodes[target].isDirectory) {
+            result.push_back("Invalid directory: " + path);
+            return result;
+        }
+    }
+
+    // ֵ˳г
+    for (uint32_t child = inodes[target].firstChild; child != NO_INODE; child = inodes[child].nextSibling) {
+        std::string line(inodes[child].isDirectory ? "[DIR] " : "[FILE] ");
+        line += inodes.name(child);
+        result.push_back(std::move(line));
+    }
+
+    return result;
+}
+
+bool FileSystem::changeDir(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    uint32_t newDir = NO_INODE;
+    if (!findEntry(path, &newDir, nullptr) || !inodes[newDir].isDirectory) {
+        return false;
+    }
+
+    currentDir = newDir;
+    return true;
+}
+
+// ƶֻinodeĸĿ¼֣inodeŲ䣬Ѵ򿪵ľȻЧ
+bool FileSystem::rename(const std::string& from, const std::string& to) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    uint32_t entry = NO_INODE;
+    uint32_t oldParent = NO_INODE;
+    if (!findEntry(from, &entry, &oldParent) || oldParent == NO_INODE) {
+        return false; // Ŀ¼ƶ
+    }
+
+    std::string_view parentPath, newName;
+    splitPath(to, parentPath, newName);
+    if (newName.empty() || newName == "." || newName == "..") {
+        return false;
+    }
+
+    uint32_t newParent = NO_INODE;
+    if (!findEntry(parentPath, &newParent, nullptr) || !inodes[newParent].isDirectory) {
+        return false;
+    }
+    if (inodes.find(newParent, newName) != NO_INODE) {
+        return false;
+    }
+
+    // Ŀ¼ƶԼ
+    for (uint32_t p = newParent; p != NO_INODE; p = inodes[p].parent) {
+        if (p == entry) return false;
+    }
+
+    std::string oldPath = journal.isOpen() ? pathOf(entry) : std::string();
+    if (!inodes.move(entry, newParent, newName)) {
+        return false;
+    }
+    if (journal.isOpen()) {
+        std::lock_guard<std::mutex> logLock(journalLock);
+        journal.begin(JR_RENAME);
+        journal.putString(oldPath);
+        journal.putString(pathOf(entry));
+        return journal.end();
+    }
+    return true;
+}
+
+// ļʵ
+bool FileSystem::createFile(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+
+    // ļ͸Ŀ¼·
+    std::string_view parentPath, fileName;
+    splitPath(path, parentPath, fileName);
+
+    // ҸĿ¼
+    uint32_t parent = NO_INODE;
+    if (!findEntry(parentPath, &parent, nullptr) || !inodes[parent].isDirectory) {
+        return false;
+    }
+
+    // ǷѴ
+    if (inodes.find(parent, fileName) != NO_INODE) {
+        return false;
+    }
+
+    // ļռ飬дʱٷֱӷinode
+    uint32_t file = inodes.create(parent, fileName, false);
+    if (file == NO_INODE) {
+        return false;
+    }
+    touchInode(file);
+    return !journal.isOpen() || logPath(JR_CREATE, file);
+}
+
+bool FileSystem::openFile(const std::string& path) {
+    return open(path) != -1;
+}
+
+bool FileSystem::closeFile(const std::string& path) {
+    int handle = -1;
+    {
+        std::shared_lock<std::shared_mutex> tree(treeLock);
+        uint32_t file = NO_INODE;
+        if (!findEntry(path, &file, nullptr) || inodes[file].isDirectory) {
+            return false;
+        }
+
+        // رոļ򿪵һ
+        std::lock_guard<std::mutex> lock(handleLock);
+        for (int h = static_cast<int>(handles.size()) - 1; h >= 0; h--) {
+            if (handles[h].ino == file) {
+                handle = h;
+                break;
+            }
+        }
+    }
+    return handle >= 0 && close(handle);
+}
+
+bool FileSystem::writeFile(const std::string& path, const std::string& data) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t ino = NO_INODE;
+    if (!findEntry(path, &ino, nullptr) || inodes[ino].isDirectory) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(fileLock(ino));
+
+    // ļǷ
+    if (inodes[ino].openCount == 0) {
+        return false;
+    }
+
+    // ʧʱļѱسɿļҲҪ־
+    uint32_t generation = inodes[ino].generation;
+    bool ok = replaceContent(ino, data);
+    if (journal.isOpen() && (ok || inodes[ino].generation != generation)) {
+        std::lock_guard<std::mutex> logLock(journalLock);
+        journal.begin(JR_WRITE);
+        journal.putString(pathOf(ino));
+        journal.putString(ok ? std::string_view(data) : std::string_view());
+        if (!journal.end()) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// data滻ļȫݣռļ
+// ռ䲻ʱļԭfalseֻм֮ռ䱻߳õʱļűɿļ
+bool FileSystem::replaceContent(uint32_t ino, std::string_view data) {
+    // ѹļѹ֮ȥء͸ƶѹֽ
+    bool inlined = data.size() <= INLINE_DATA_BYTES;
+    bool compressed = inodes[ino].compressed && !inlined;
+    std::string packed;
+    std::vector<uint32_t> ends;
+    std::string_view stored = data;
+    if (compressed) {
+        encodeChunks(data, 0, packed, ends);
+        stored = packed;
+    }
+
+    // ȥʱͬĿҵ͹ãٷ
+    bool dedup = dedupEnabled && !inlined;
+    uint64_t hash = 0;
+    uint32_t shared = FAT_EOC;
+    uint32_t sharedBirth = 0;
+    if (dedup) {
+        auto start = std::chrono::steady_clock::now();
+        hash = ContentHash::compute(stored.data(), stored.size());
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        shared = findDuplicate(hash, nanos, stored, sharedBirth);
+    }
+
+    // ԭеĿͷźãջļõĳ⣻ͬпԷŲʱļԭ
+    uint32_t blocksNeeded = (!inlined && shared == FAT_EOC) ?
+        static_cast<uint32_t>((stored.size() + blockSize - 1) / blockSize) : 0;
+    int oldStart = inodes[ino].startBlock;
+    uint32_t blocksHeld = (oldStart < 0 || chainCaptured(ino) || chainRefs(static_cast<uint32_t>(oldStart)) > 1) ?
+        0 : fileBlocks(fileMap(ino));
+    if (blocksNeeded > allocator.freeCount() + blocksHeld) {
+        return false;
+    }
+
+    // ԭпʱ
+    dropChain(ino);
+    Inode& file = inodes.edit(ino);
+    FileMap* mapEntry;
+    {
+        // ԭͷţFATα
+        std::lock_guard<std::mutex> mapGuard(mapLock);
+        mapEntry = &fileMaps[ino];
+    }
+    FileMap& map = *mapEntry;
+    map.extents.clear();
+    map.seekIndex.clear();
+    map.chunkEnds.clear();
+
+    int size = data.size();
+    file.storedSize = 0;
+    if (size > 0 && inlined) {
+        // Сļ
+        memcpy(file.inlineData, data.data(), size);
+        file.startBlock = INLINE_BLOCK;
+        file.size = size;
+        file.generation++;
+        touchInode(ino);
+        return true;
+    }
+
+    // ļһԷ䣬һռ
+    std::vector<Extent> extents;
+    if (shared != FAT_EOC) {
+        chainExtents(shared, (stored.size() + blockSize - 1) / blockSize, extents);
+    }
+    else if (!allocateExtents(blocksNeeded, extents)) {
+        // ԭͷţļɿļָɿ
+        file.startBlock = -1;
+        file.size = 0;
+        file.generation++;
+        touchInode(ino);
+        return false;
+    }
+    else {
+        linkExtents(extents);
+
+        // ݣÿһmemcpy
+        uint64_t offset = 0;
+        for (const Extent& e : extents) {
+            uint64_t bytesToCopy = std::min<uint64_t>(uint64_t(e.count) * blockSize, stored.size() - offset);
+            device->write(uint64_t(e.start) * blockSize, stored.data() + offset, bytesToCopy);
+            markBytes(uint64_t(e.start) * blockSize, bytesToCopy);
+            offset += bytesToCopy;
+        }
+        sharedBirth = inodes.currentEpoch();
+        if (dedup && !extents.empty()) {
+            indexChain(extents[0].start, hash, stored.size(), sharedBirth);
+        }
+    }
+
+    // ļϢλ֮ʧЧ
+    file.startBlock = extents.empty() ? -1 : static_cast<int>(extents[0].start);
+    file.chainEpoch = sharedBirth;
+    file.size = size;
+    if (compressed) {
+        file.storedSize = static_cast<uint32_t>(stored.size());
+        map.chunkEnds.swap(ends);
+        map.chunkToken = ++nextChunkToken;
+    }
+    map.extents.swap(extents);
+    buildSeekIndex(map);
+    file.generation++;
+    touchInode(ino);
+    return true;
+}
+
+bool FileSystem::appendFile(const std::string& path, std::string_view data) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t ino = NO_INODE;
+    if (!findEntry(path, &ino, nullptr) || inodes[ino].isDirectory) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(fileLock(ino));
+    if (inodes[ino].openCount == 0) {
+        return false;
+    }
+
+    // һοʼشͷλ
+    FileMap& map = fileMap(ino);
+    FilePos pos = { 0, 0 };
+    if (!map.extents.empty() && map.seekIndex.size() == map.extents.size()) {
+        pos = FilePos{ map.extents.size() - 1, map.seekIndex.back() };
+    }
+    return writeLocked(ino, inodes[ino].size, data, pos);
+}
+
+std::string FileSystem::readFile(const std::string& path, int size) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t file = NO_INODE;
+    if (!findEntry(path, &file, nullptr) || inodes[file].isDirectory) {
+        return "";
+    }
+    std::shared_lock<std::shared_mutex> lock(fileLock(file));
+
+    // ļǷ
+    if (inodes[file].openCount == 0) {
+        return "";
+    }
+
+    if (size == -1 || size > inodes[file].size) {
+        size = inodes[file].size;
+    }
+
+    if (inodes[file].startBlock == INLINE_BLOCK) {
+        return std::string(inodes[file].inlineData, size);
+    }
+
+    // ζȡ
+    std::string content(size, '\0');
+    FilePos pos = { 0, 0 };
+    if (inodes[file].compressed) {
+        readCompressed(fileMap(file), inodes[file], 0, &content[0], size, pos);
+    }
+    else {
+        readData(fileMap(file), 0, &content[0], size, pos);
+    }
+    return content;
+}
+
+bool FileSystem::deleteFile(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    uint32_t file = NO_INODE;
+    uint32_t parent = NO_INODE;
+
+    if (!findEntry(path, &file, &parent) || inodes[file].isDirectory) {
+        return false;
+    }
+
+    // ļǷ
+    if (inodes[file].openCount > 0) {
+        return false;
     }
-    return -1; // ޿ÿ
-}
 
-void FileSystem::freeBlockChain(int startBlock) {
-    int block = startBlock;
-    while (block != -1 && block != 0xFFFF) {
-        int next = fat[block];
-        int byteIndex = block / 8;
-        int bitIndex = block % 8;
-        bitmap[byteIndex] &= ~(1 << bitIndex); // Ϊ
-        fat[block] = 0;
-        block = next;
+    // ͷݿ飬õͷ
+    dropChain(file);
+    fileMaps.erase(file);
+
+    // ӸĿ¼ɾinodeŻ
+    bool logged = true;
+    if (parent != NO_INODE) {
+        logged = !journal.isOpen() || logPath(JR_DELETE, file);
+        inodes.remove(file);
     }
+    return logged;
 }
 
-// ·
-bool FileSystem::findEntry(const std::string& path, DirEntry** entry, DirEntry** parent) {
-    if (path.empty()) {
-        if (entry) *entry = currentDir;
-        if (parent) *parent = nullptr;
+bool FileSystem::setCompressed(const std::string& path, bool enabled) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t ino = NO_INODE;
+    if (!findEntry(path, &ino, nullptr) || inodes[ino].isDirectory) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(fileLock(ino));
+    if (bool(inodes[ino].compressed) == enabled) {
         return true;
     }
 
-    std::vector<std::string> parts;
-    std::istringstream iss(path);
-    std::string part;
-
-    // ָ·
-    while (std::getline(iss, part, '/')) {
-        if (!part.empty()) {
-            parts.push_back(part);
+    // ϵݰԭķʽдأͿļûҪת
+    std::string content;
+    if (inodes[ino].startBlock >= 0) {
+        content.resize(inodes[ino].size);
+        FilePos pos = { 0, 0 };
+        if (inodes[ino].compressed) {
+            readCompressed(fileMap(ino), inodes[ino], 0, &content[0], content.size(), pos);
+        }
+        else {
+            readData(fileMap(ino), 0, &content[0], content.size(), pos);
         }
     }
-
-    DirEntry* cur = currentDir;
-    if (path[0] == '/') {
-        cur = &root; // ·Ӹʼ
+    uint32_t generation = inodes[ino].generation;
+    inodes.edit(ino).compressed = enabled;
+    touchInode(ino);
+    bool ok = inodes[ino].startBlock < 0 || replaceContent(ino, content);
+    bool truncated = !ok && inodes[ino].generation != generation;
+    if (!ok && !truncated) {
+        inodes.edit(ino).compressed = !enabled;
     }
 
-    if (parent) *parent = nullptr;
-
-    for (size_t i = 0; i < parts.size(); i++) {
-        const std::string& name = parts[i];
-
-        if (name == ".") {
-            // ǰĿ¼ı
-            continue;
+    if (journal.isOpen() && (ok || truncated)) {
+        std::lock_guard<std::mutex> logLock(journalLock);
+        journal.begin(JR_COMPRESS);
+        journal.putString(pathOf(ino));
+        journal.putU64(enabled ? 1 : 0);
+        bool logged = journal.end();
+        if (truncated) {
+            journal.begin(JR_WRITE);
+            journal.putString(pathOf(ino));
+            journal.putString(std::string_view());
+            logged = journal.end() && logged;
         }
-
-        if (name == "..") {
-            // Ŀ¼
-            if (cur == &root) {
-                // Ŀ¼ûиĿ¼
-                continue;
-            }
-
-            if (parent) {
-                // ҵĿ¼ĸĿ¼
-                DirEntry* temp = cur;
-                cur = nullptr;
-                for (auto& p : root.children) {
-                    for (auto& c : p.second.children) {
-                        if (&c.second == temp) {
-                            cur = &p.second;
-                            break;
-                        }
-                    }
-                    if (cur) break;
-                }
-                if (!cur) return false;
-            }
-            continue;
+        if (!logged) {
+            ok = false;
         }
+    }
+    return ok;
+}
 
-        auto it = cur->children.find(name);
-        if (it == cur->children.end()) {
-            return false; // δҵ
-        }
+bool FileSystem::fileSizes(const std::string& path, uint64_t& size, uint64_t& stored) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t ino = NO_INODE;
+    if (!findEntry(path, &ino, nullptr) || inodes[ino].isDirectory) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(fileLock(ino));
+    size = uint64_t(inodes[ino].size);
+    stored = storedBytes(inodes[ino]);
+    return true;
+}
 
-        if (i == parts.size() - 1) {
-            if (entry) *entry = &it->second;
-            return true;
-        }
+// ʵ
+// handleLock¸ƳʹãдٰλдأͬһϵĲд֮䲻֤˳
+bool FileSystem::getHandle(int handle, FileHandle& out) {
+    std::lock_guard<std::mutex> lock(handleLock);
+    if (handle < 0 || handle >= static_cast<int>(handles.size()) || handles[handle].ino == NO_INODE) {
+        return false;
+    }
+    out = handles[handle];
+    return true;
+}
 
-        if (!it->second.isDirectory) {
-            return false; // ·м䲻ļ
-        }
+// дضдڵΣadvanceΪдλõƽѹرʱд
+void FileSystem::updateHandle(int handle, const FileHandle& h, uint64_t advance) {
+    std::lock_guard<std::mutex> lock(handleLock);
+    FileHandle& target = handles[handle];
+    if (target.ino != h.ino) return;
+
+    target.pos = h.pos;
+    target.generation = h.generation;
+    target.readEnd = h.readEnd;
+    target.aheadEnd = h.aheadEnd;
+    target.window = h.window;
+    target.writeEnd = h.writeEnd;
+    target.writtenBack = h.writtenBack;
+    target.cursor += advance;
+}
 
-        if (parent) *parent = cur;
-        cur = &it->second;
+// ļα滻󣬾λϣиļ
+FilePos& FileSystem::handlePos(FileHandle& h) {
+    if (h.generation != inodes[h.ino].generation) {
+        h.pos = FilePos{ 0, 0 };
+        h.generation = inodes[h.ino].generation;
     }
+    return h.pos;
+}
 
-    if (entry) *entry = cur;
-    return true;
+// ļ[from, to)ڵĿţposΪҵ
+void FileSystem::rangeBlocks(FileMap& map, uint64_t from, uint64_t to, FilePos pos, std::vector<uint32_t>& out) {
+    seekExtent(map, from, pos);
+    uint64_t offset = from;
+    while (offset < to && pos.extent < map.extents.size()) {
+        const Extent& e = map.extents[pos.extent];
+        uint64_t first = (offset - pos.extentOffset) / blockSize;
+        uint64_t last = std::min<uint64_t>(e.count, (to - pos.extentOffset + blockSize - 1) / blockSize);
+        for (uint64_t i = first; i < last; i++) {
+            out.push_back(static_cast<uint32_t>(e.start + i));
+        }
+        pos.extentOffset += uint64_t(e.count) * blockSize;
+        pos.extent++;
+        offset = pos.extentOffset;
+    }
 }
 
-void FileSystem::format() {
-    // λͼ
-    memset(bitmap, 0, BITMAP_SIZE);
+// һԤдز1/4ðѸշŽȥĿּȥ
+uint64_t FileSystem::streamLimit(uint64_t bytes) const {
+    return std::max<uint64_t>(std::min(bytes, fileDevice->cacheBytes() / 4), blockSize);
+}
 
-    // ʼFAT
-    for (int i = 0; i < FAT_ENTRY_COUNT; i++) {
-        fat[i] = 0;
+// ϴνʱԤڷԤ
+// ԤĲʣ²ʱһڵĿһ
+void FileSystem::readAhead(FileHandle& h, FileMap& map, uint64_t offset, uint64_t len) {
+    uint64_t end = offset + len;
+    if (offset != h.readEnd) {
+        h.window = 0;
+        h.aheadEnd = 0;
+    }
+    else {
+        h.window = streamLimit(std::min(h.window ? h.window * 2 : READAHEAD_MIN_BYTES, READAHEAD_MAX_BYTES));
     }
+    h.readEnd = end;
+    if (h.window == 0) return;
 
-    // ؽĿ¼
-    root.children.clear();
-    currentDir = &root;
-    openFiles.clear();
+    uint64_t from = std::max(h.aheadEnd, end);
+    uint64_t to = std::min(end + h.window, uint64_t(inodes[h.ino].size));
+    if (from - end >= h.window / 2 || from >= to) return;
+
+    std::vector<uint32_t> blocks;
+    rangeBlocks(map, from, to, h.pos, blocks);
+    device->prefetch(blocks.data(), blocks.size());
+    h.aheadEnd = to;
 }
 
-void FileSystem::serializeDir(std::ofstream& ofs, DirEntry* dir) {
-    size_t count = dir->children.size();
-    ofs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+// ϴνдʱдĿܹһһдأڵĿϳɴд
+// صȻ̭ʱһһдռļ
+void FileSystem::writeBehind(FileHandle& h, FileMap& map, uint64_t offset, uint64_t len) {
+    uint64_t end = offset + len;
+    if (offset != h.writeEnd) {
+        h.writtenBack = offset - offset % blockSize;
+    }
+    h.writeEnd = end;
 
-    for (const auto& child : dir->children) {
-        const std::string& name = child.first;
-        const DirEntry& entry = child.second;
+    uint64_t full = end - end % blockSize;
+    if (full <= h.writtenBack || full - h.writtenBack < streamLimit(WRITE_BEHIND_BYTES)) return;
 
-        // дļ
-        size_t nameLen = name.size();
-        ofs.write(reinterpret_cast<const char*>(&nameLen), sizeof(nameLen));
-        ofs.write(name.c_str(), nameLen);
+    std::vector<uint32_t> blocks;
+    rangeBlocks(map, h.writtenBack, full, h.pos, blocks);
+    device->writeBack(blocks.data(), blocks.size());
+    h.writtenBack = full;
+}
 
-        // дĿ¼
-        ofs.write(reinterpret_cast<const char*>(&entry.isDirectory), sizeof(bool));
-        ofs.write(reinterpret_cast<const char*>(&entry.startBlock), sizeof(int));
-        ofs.write(reinterpret_cast<const char*>(&entry.size), sizeof(int));
+// һڴʱϲ
+void ReadLease::add(const char* data, size_t len) {
+    if (!parts.empty() && parts.back().data + parts.back().len == data) {
+        parts.back().len += len;
+        return;
+    }
+    parts.push_back(DataSpan{ data, len });
+}
 
-        // Ŀ¼ݹл
-        if (entry.isDirectory) {
-            serializeDir(ofs, const_cast<DirEntry*>(&dir->children.at(name)));
-        }
+uint64_t ReadLease::size() const {
+    uint64_t total = 0;
+    for (const DataSpan& span : parts) {
+        total += span.len;
     }
+    return total;
 }
 
-void FileSystem::deserializeDir(std::ifstream& ifs, DirEntry* dir) {
-    size_t count;
-    ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
+// Ƚⶤ飬ٷſļĿ¼
+void ReadLease::release() {
+    for (uint32_t block : pinned) {
+        device->unpin(block);
+    }
+    pinned.clear();
+    parts.clear();
+    copies.clear();
+    device = nullptr;
+    if (file.owns_lock()) file.unlock();
+    if (tree.owns_lock()) tree.unlock();
+}
 
-    for (size_t i = 0; i < count; i++) {
-        // ȡļ
-        size_t nameLen;
-        ifs.read(reinterpret_cast<char*>(&nameLen), sizeof(nameLen));
-        std::vector<char> nameBuf(nameLen);
-        ifs.read(nameBuf.data(), nameLen);
-        std::string name(nameBuf.begin(), nameBuf.end());
+void FileSystem::closeAllHandles() {
+    handles.clear();
+    freeHandles.clear();
+}
 
-        // Ŀ¼
-        DirEntry entry;
-        ifs.read(reinterpret_cast<char*>(&entry.isDirectory), sizeof(bool));
-        ifs.read(reinterpret_cast<char*>(&entry.startBlock), sizeof(int));
-        ifs.read(reinterpret_cast<char*>(&entry.size), sizeof(int));
-        entry.name = name;
+int FileSystem::open(const std::string& path) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t file = NO_INODE;
+    if (!findEntry(path, &file, nullptr) || inodes[file].isDirectory) {
+        return -1;
+    }
+    std::unique_lock<std::shared_mutex> lock(fileLock(file));
+    inodes.edit(file).openCount++;
+
+    // ȸѹرյľ
+    std::lock_guard<std::mutex> handleGuard(handleLock);
+    int handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else {
+        handle = static_cast<int>(handles.size());
+        handles.push_back(FileHandle());
+    }
 
-        // ӵǰĿ¼
-        dir->children[name] = entry;
+    FileHandle& h = handles[handle];
+    h.ino = file;
+    h.cursor = 0;
+    h.pos = FilePos{ 0, 0 };
+    h.generation = inodes[file].generation;
+    h.readEnd = h.aheadEnd = h.window = 0;
+    h.writeEnd = h.writtenBack = 0;
+    return handle;
+}
 
-        // Ŀ¼ݹ
-        if (entry.isDirectory) {
-            deserializeDir(ifs, &dir->children[name]);
+bool FileSystem::close(int handle) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    uint32_t file;
+    {
+        std::lock_guard<std::mutex> lock(handleLock);
+        if (handle < 0 || handle >= static_cast<int>(handles.size()) || handles[handle].ino == NO_INODE) {
+            return false;
         }
+        file = handles[handle].ino;
+        handles[handle].ino = NO_INODE;
+        freeHandles.push_back(handle);
     }
+
+    std::unique_lock<std::shared_mutex> lock(fileLock(file));
+    inodes.edit(file).openCount--;
+    return true;
 }
 
+bool FileSystem::seek(int handle, int offset) {
+    if (offset < 0) return false;
 
-void FileSystem::saveToDisk(const std::string& filename) {
-    std::ofstream ofs(filename, std::ios::binary);
-    if (!ofs) return;
+    std::lock_guard<std::mutex> lock(handleLock);
+    if (handle < 0 || handle >= static_cast<int>(handles.size()) || handles[handle].ino == NO_INODE) {
+        return false;
+    }
+    handles[handle].cursor = offset;
+    return true;
+}
 
-    // Ԫ
-    ofs.write(reinterpret_cast<char*>(bitmap), BITMAP_SIZE);
-    ofs.write(reinterpret_cast<char*>(fat), FAT_ENTRY_COUNT * sizeof(uint16_t));
+std::string FileSystem::read(int handle, int size) {
+    if (size < 0) return "";
 
-    // Ŀ¼ṹ
-    serializeDir(ofs, &root);
-    ofs.close();
+    std::string content(size, '\0');
+    int bytesRead = readHandle(handle, 0, size, &content[0], true);
+    if (bytesRead < 0) return "";
+
+    content.resize(bytesRead);
+    return content;
 }
 
-void FileSystem::loadFromDisk(const std::string& filename) {
-    std::ifstream ifs(filename, std::ios::binary);
-    if (!ifs) return;
+int FileSystem::write(int handle, const std::string& data) {
+    return writeHandle(handle, 0, data, WRITE_CURSOR);
+}
 
-    // Ԫ
-    ifs.read(reinterpret_cast<char*>(bitmap), BITMAP_SIZE);
-    ifs.read(reinterpret_cast<char*>(fat), FAT_ENTRY_COUNT * sizeof(uint16_t));
+int FileSystem::pread(int handle, int offset, int len, char* buf) {
+    return readHandle(handle, offset, len, buf, false);
+}
 
-    // Ŀ¼ṹ
-    root.children.clear();
-    deserializeDir(ifs, &root);
-    currentDir = &root;
-    openFiles.clear();
+int FileSystem::pwrite(int handle, int offset, const std::string& data) {
+    return writeHandle(handle, offset, data, WRITE_AT);
 }
 
-// Ŀ¼ʵ
-bool FileSystem::mkdir(const std::string& path) {
-    // Ŀ¼͸Ŀ¼·
-    size_t pos = path.find_last_of('/');
-    std::string dirName, parentPath;
+// atCursorΪʱӾĶдλÿʼѶдλƽֽ
+int FileSystem::readHandle(int handle, int offset, int len, char* buf, bool atCursor) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    FileHandle h;
+    if (!getHandle(handle, h)) {
+        return -1;
+    }
+    if (atCursor) {
+        offset = static_cast<int>(h.cursor);
+    }
+    if (offset < 0 || len < 0) {
+        return -1;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(fileLock(h.ino));
+    const Inode& file = inodes[h.ino];
+    if (offset >= file.size) {
+        return 0;
+    }
 
-    if (pos == std::string::npos) {
-        // ڵǰĿ¼
-        dirName = path;
-        parentPath = "";
+    // ˳ʱϴͣµμشӵһ
+    len = std::min(len, file.size - offset);
+    if (file.startBlock == INLINE_BLOCK) {
+        memcpy(buf, file.inlineData + offset, len);
+    }
+    else if (file.compressed) {
+        readCompressed(fileMap(h.ino), file, offset, buf, len, handlePos(h));
     }
     else {
-        dirName = path.substr(pos + 1);
-        parentPath = path.substr(0, pos);
+        FileMap& map = fileMap(h.ino);
+        readData(map, offset, buf, len, handlePos(h));
+        if (fileDevice) {
+            readAhead(h, map, offset, len);
+        }
     }
+    updateHandle(handle, h, atCursor ? len : 0);
+    return len;
+}
 
-    // ҸĿ¼
-    DirEntry* parent = nullptr;
-    if (!findEntry(parentPath, &parent, nullptr) || !parent || !parent->isDirectory) {
-        return false;
+// ڴӳľֱָڴ棻ȰЩһ棬鶤ס
+int FileSystem::readSpans(int handle, int offset, int len, ReadLease& lease) {
+    lease.release();
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    FileHandle h;
+    if (!getHandle(handle, h) || offset < 0 || len < 0) {
+        return -1;
     }
 
-    // ǷѴ
-    if (parent->children.find(dirName) != parent->children.end()) {
-        return false;
+    std::shared_lock<std::shared_mutex> lock(fileLock(h.ino));
+    const Inode& file = inodes[h.ino];
+    if (offset >= file.size) {
+        return 0;
+    }
+    len = std::min(len, file.size - offset);
+    if (file.startBlock == INLINE_BLOCK) {
+        // ָinode¼ԼĿ¼Ķ¼鲻
+        lease.add(file.inlineData + offset, len);
+        lease.file = std::move(lock);
+        lease.tree = std::move(tree);
+        return len;
     }
 
-    // Ŀ¼
-    DirEntry newDir;
-    newDir.name = dirName;
-    newDir.isDirectory = true;
-    newDir.startBlock = -1; // Ŀ¼ʹݿ
-    newDir.size = 0;
+    FileMap& map = fileMap(h.ino);
+    FilePos& pos = handlePos(h);
+    if (file.compressed) {
+        // ѹļֻܽѹһ
+        lease.copies.emplace_back(new char[len]);
+        readCompressed(map, file, offset, lease.copies.back().get(), len, pos);
+        lease.add(lease.copies.back().get(), len);
+        updateHandle(handle, h, 0);
+        lease.file = std::move(lock);
+        lease.tree = std::move(tree);
+        return len;
+    }
+    if (fileDevice) {
+        std::vector<uint32_t> blocks;
+        rangeBlocks(map, offset, uint64_t(offset) + len, pos, blocks);
+        if (uint64_t(blocks.size()) * blockSize <= streamLimit(READAHEAD_MAX_BYTES)) {
+            fileDevice->prefetch(blocks.data(), blocks.size());
+        }
+        lease.device = fileDevice;
+    }
 
-    parent->children[dirName] = newDir;
-    return true;
+    seekExtent(map, offset, pos);
+    uint64_t at = offset;
+    uint64_t left = len;
+    while (left > 0 && pos.extent < map.extents.size()) {
+        const Extent& e = map.extents[pos.extent];
+        uint64_t extentBytes = uint64_t(e.count) * blockSize;
+        uint64_t skip = at - pos.extentOffset;
+        uint64_t n = std::min(left, extentBytes - skip);
+        uint64_t addr = uint64_t(e.start) * blockSize + skip;
+        if (!fileDevice) {
+            lease.add(memory + addr, n);
+        }
+        // 鶤סﶤסĿ鸴һ
+        for (uint64_t a = addr; fileDevice && a < addr + n; ) {
+            uint32_t block = static_cast<uint32_t>(a / blockSize);
+            uint64_t within = a % blockSize;
+            uint64_t m = std::min<uint64_t>(addr + n - a, blockSize - within);
+            const char* data = fileDevice->pin(block);
+            if (data) {
+                lease.pinned.push_back(block);
+                lease.add(data + within, m);
+            }
+            else {
+                lease.copies.emplace_back(new char[m]);
+                device->read(a, lease.copies.back().get(), m);
+                lease.add(lease.copies.back().get(), m);
+            }
+            a += m;
+        }
+        at += n;
+        left -= n;
+        if (skip + n == extentBytes) {
+            pos.extentOffset += extentBytes;
+            pos.extent++;
+        }
+    }
+    updateHandle(handle, h, 0);
+    lease.file = std::move(lock);
+    lease.tree = std::move(tree);
+    return len;
 }
 
-bool FileSystem::rmdir(const std::string& path) {
-    DirEntry* dir = nullptr;
-    DirEntry* parent = nullptr;
+int FileSystem::writeHandle(int handle, int offset, std::string_view data, WriteMode mode) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    FileHandle h;
+    if (!getHandle(handle, h)) {
+        return -1;
+    }
+    if (mode == WRITE_CURSOR) {
+        offset = static_cast<int>(h.cursor);
+    }
+    if (offset < 0) {
+        return -1;
+    }
 
-    if (!findEntry(path, &dir, &parent) || !dir || !dir->isDirectory) {
-        return false;
+    uint32_t ino = h.ino;
+    std::unique_lock<std::shared_mutex> lock(fileLock(ino));
+    if (mode == WRITE_APPEND) {
+        offset = inodes[ino].size;
     }
+    if (!writeLocked(ino, offset, data, handlePos(h))) {
+        return -1;
+    }
+    if (fileDevice && !inodes[ino].compressed) {
+        writeBehind(h, fileMap(ino), offset, data.size());
+    }
+    updateHandle(handle, h, mode == WRITE_CURSOR ? data.size() : 0);
+    return static_cast<int>(data.size());
+}
 
-    // Ŀ¼ǷΪ
-    if (!dir->children.empty()) {
+// dataдļoffsetдп֮ʱ׷ӿ飬дļĩβ֮ʱм䲹0
+// ռļ
+bool FileSystem::writeLocked(uint32_t ino, uint64_t offset, std::string_view data, FilePos& pos) {
+    uint64_t end = offset + data.size();
+    if (end > INT_MAX) {
         return false;
     }
 
-    // ӸĿ¼ɾ
-    if (parent) {
-        parent->children.erase(dir->name);
+    // дԲ޵ĿļļֱӸinode¼
+    Inode& file = inodes.edit(ino);
+    bool empty = file.startBlock == -1 && file.size == 0;
+    bool fitsInline = (empty || file.startBlock == INLINE_BLOCK) && end <= INLINE_DATA_BYTES;
+    if (file.compressed && !fitsInline) {
+        if (!writeCompressed(ino, offset, data, pos)) {
+            return false;
+        }
     }
-    return true;
-}
+    else if (fitsInline) {
+        if (offset > uint64_t(file.size)) {
+            memset(file.inlineData + file.size, 0, offset - file.size);
+        }
+        memcpy(file.inlineData + offset, data.data(), data.size());
+        if (end > uint64_t(file.size)) {
+            file.size = static_cast<int>(end);
+        }
+        if (end > 0) {
+            file.startBlock = INLINE_BLOCK;
+        }
+        touchInode(ino);
+    }
+    else {
+        if (file.startBlock == INLINE_BLOCK && !moveInlineToBlocks(ino, pos)) {
+            return false;
+        }
+        bool shared = chainShared(ino);
+        if ((shared || chainCaptured(ino)) && !unshareChain(ino, pos)) {
+            return false;
+        }
 
-std::vector<std::string> FileSystem::listDir(const std::string& path) {
-    std::vector<std::string> result;
-    DirEntry* target = currentDir;
+        FileMap& map = fileMap(ino);
+        uint64_t capacity = uint64_t(fileBlocks(map)) * blockSize;
+        if (end > capacity) {
+            uint32_t more = static_cast<uint32_t>((end - capacity + blockSize - 1) / blockSize);
+            if (!extendFile(ino, more)) {
+                return false;
+            }
+        }
 
-    if (!path.empty()) {
-        if (!findEntry(path, &target, nullptr) || !target || !target->isDirectory) {
-            result.push_back("Invalid directory: " + path);
-            return result;
+        if (offset > uint64_t(file.size)) {
+            writeData(map, file.size, nullptr, offset - file.size, pos);
+        }
+        writeData(map, offset, data.data(), data.size(), pos);
+        if (end > uint64_t(file.size)) {
+            file.size = static_cast<int>(end);
+            touchInode(ino);
         }
     }
+    if (journal.isOpen()) {
+        std::lock_guard<std::mutex> logLock(journalLock);
+        journal.begin(JR_PWRITE);
+        journal.putString(pathOf(ino));
+        journal.putU64(offset);
+        journal.putString(data);
+        return journal.end();
+    }
+    return true;
+}
 
-    // ޸ʹC++11ݵĵʽ
-    for (auto it = target->children.begin(); it != target->children.end(); ++it) {
-        const std::string& name = it->first;
-        const DirEntry& entry = it->second;
-        result.push_back((entry.isDirectory ? "[DIR] " : "[FILE] ") + name);
+// ļʱݰᵽαԭΪգposȻЧ
+bool FileSystem::moveInlineToBlocks(uint32_t ino, FilePos& pos) {
+    Inode& file = inodes.edit(ino);
+    std::string content(file.inlineData, file.size);
+    file.startBlock = -1;
+    if (!extendFile(ino, static_cast<uint32_t>((content.size() + blockSize - 1) / blockSize))) {
+        file.startBlock = INLINE_BLOCK;
+        return false;
     }
+    writeData(fileMap(ino), 0, content.data(), content.size(), pos);
+    touchInode(ino);
+    return true;
+}
 
-    return result;
+// ļڿϵֽѹļѹݼӿͿļΪ0
+uint64_t FileSystem::storedBytes(const Inode& file) {
+    if (file.startBlock < 0) return 0;
+    return file.compressed ? file.storedSize : uint64_t(file.size);
 }
 
-bool FileSystem::changeDir(const std::string& path) {
-    DirEntry* newDir = nullptr;
-    if (!findEntry(path, &newDir, nullptr) || !newDir || !newDir->isDirectory) {
-        return false;
+// ѹļڿϵĲ֣[0][1]...[]ǸνƫƵuint32飬ļС
+// ѹ󲻱ԭСĶԭţʱ֡dataѹ׷ӵoutһδӿbaseʼ
+// εĽƫ׷ӵendsoutĩβдendsȫΪ
+void FileSystem::encodeChunks(std::string_view data, uint64_t base, std::string& out, std::vector<uint32_t>& ends) {
+    std::vector<char> packed(COMPRESS_CHUNK_BYTES);
+    for (size_t offset = 0; offset < data.size(); offset += COMPRESS_CHUNK_BYTES) {
+        size_t n = std::min<size_t>(COMPRESS_CHUNK_BYTES, data.size() - offset);
+        size_t m = LzCodec::compress(data.data() + offset, n, packed.data(), n - 1);
+        if (m > 0) {
+            out.append(packed.data(), m);
+        }
+        else {
+            out.append(data.data() + offset, n);
+        }
+        ends.push_back(static_cast<uint32_t>(base + out.size()));
     }
+    out.append(reinterpret_cast<const char*>(ends.data()), ends.size() * sizeof(uint32_t));
+}
 
-    currentDir = newDir;
-    return true;
+// ӿĩβѹļĿαʱ
+void FileSystem::loadChunkTable(FileMap& map, const Inode& file) {
+    if (!file.compressed || file.startBlock < 0) return;
+    size_t chunks = (uint64_t(file.size) + COMPRESS_CHUNK_BYTES - 1) / COMPRESS_CHUNK_BYTES;
+    uint64_t tableBytes = chunks * sizeof(uint32_t);
+    map.chunkEnds.assign(chunks, 0);
+    if (file.storedSize >= tableBytes) {
+        FilePos pos = { 0, 0 };
+        readData(map, file.storedSize - tableBytes, reinterpret_cast<char*>(map.chunkEnds.data()), tableBytes, pos);
+    }
+    map.chunkToken = ++nextChunkToken;
 }
 
-// ļʵ
-bool FileSystem::createFile(const std::string& path) {
-    // ļ͸Ŀ¼·
-    size_t pos = path.find_last_of('/');
-    std::string fileName, parentPath;
+// ѹļ[offset, offset+len)ԭŵĶֱӶνѹ̵߳Ļٸƣ
+// ѹݶԲʱ0
+void FileSystem::readCompressed(FileMap& map, const Inode& file, uint64_t offset, char* buf, uint64_t len, FilePos& pos) {
+    std::vector<char> packed;
+    while (len > 0) {
+        size_t chunk = offset / COMPRESS_CHUNK_BYTES;
+        uint64_t chunkStart = uint64_t(chunk) * COMPRESS_CHUNK_BYTES;
+        uint64_t chunkLen = std::min<uint64_t>(COMPRESS_CHUNK_BYTES, file.size - chunkStart);
+        uint64_t skip = offset - chunkStart;
+        uint64_t n = std::min(len, chunkLen - skip);
+        uint64_t from = chunk ? map.chunkEnds[chunk - 1] : 0;
+        uint64_t to = chunk < map.chunkEnds.size() ? map.chunkEnds[chunk] : 0;
+
+        if (to < from || to - from > chunkLen) {
+            memset(buf, 0, n);
+        }
+        else if (to - from == chunkLen) {
+            readData(map, from + skip, buf, n, pos);
+        }
+        else {
+            if (chunkCache.token != map.chunkToken || chunkCache.chunk != chunk) {
+                packed.resize(to - from);
+                readData(map, from, packed.data(), packed.size(), pos);
+                chunkCache.data.resize(chunkLen);
+                bool ok = LzCodec::decompress(packed.data(), packed.size(), chunkCache.data.data(), chunkLen);
+                chunkCache.token = ok ? map.chunkToken : 0;
+                chunkCache.chunk = static_cast<uint32_t>(chunk);
+                if (!ok) memset(chunkCache.data.data(), 0, chunkLen);
+            }
+            memcpy(buf, chunkCache.data.data() + skip, n);
+        }
+        buf += n;
+        offset += n;
+        len -= n;
+    }
+}
 
-    if (pos == std::string::npos) {
-        // ڵǰĿ¼
-        fileName = path;
-        parentPath = "";
+// дѹļдڵĶ𣬰ѵļĩβѹͬдأ֮ǰĶβ
+// ׷ʱֻѹһΡдļĩβ֮ʱм䲹0ռļ
+bool FileSystem::writeCompressed(uint32_t ino, uint64_t offset, std::string_view data, FilePos& pos) {
+    Inode& file = inodes.edit(ino);
+    uint64_t size = uint64_t(file.size);
+    uint64_t end = std::max<uint64_t>(size, offset + data.size());
+    size_t first = std::min(offset, size) / COMPRESS_CHUNK_BYTES;
+    uint64_t base = uint64_t(first) * COMPRESS_CHUNK_BYTES;
+
+    // ȡҪѹԭݣһڵ0
+    std::string tail(end - base, '\0');
+    bool wasInline = file.startBlock == INLINE_BLOCK;
+    if (wasInline) {
+        memcpy(&tail[0], file.inlineData, size);
+        file.startBlock = -1;
     }
-    else {
-        fileName = path.substr(pos + 1);
-        parentPath = path.substr(0, pos);
+    else if (size > base) {
+        readCompressed(fileMap(ino), file, base, &tail[0], size - base, pos);
     }
+    memcpy(&tail[offset - base], data.data(), data.size());
 
-    // ҸĿ¼
-    DirEntry* parent = nullptr;
-    if (!findEntry(parentPath, &parent, nullptr) || !parent || !parent->isDirectory) {
+    if ((chainShared(ino) || chainCaptured(ino)) && !unshareChain(ino, pos)) {
         return false;
     }
-
-    // ǷѴ
-    if (parent->children.find(fileName) != parent->children.end()) {
+    FileMap& map = fileMap(ino);
+    std::vector<uint32_t> ends(map.chunkEnds.begin(), map.chunkEnds.begin() + first);
+    uint64_t at = first ? ends.back() : 0;
+    std::string packed;
+    encodeChunks(tail, at, packed, ends);
+
+    uint64_t stored = at + packed.size();
+    uint64_t capacity = uint64_t(fileBlocks(map)) * blockSize;
+    if (stored > capacity && !extendFile(ino, static_cast<uint32_t>((stored - capacity + blockSize - 1) / blockSize))) {
+        if (wasInline) file.startBlock = INLINE_BLOCK;
         return false;
     }
+    writeData(map, at, packed.data(), packed.size(), pos);
+    // ѹʱŲݵβ黹
+    trimChain(ino, static_cast<uint32_t>((stored + blockSize - 1) / blockSize), pos);
+    file.size = static_cast<int>(end);
+    file.storedSize = static_cast<uint32_t>(stored);
+    map.chunkEnds.swap(ends);
+    map.chunkToken = ++nextChunkToken;
+    touchInode(ino);
+    return true;
+}
 
-    // һ
-    int block = allocateBlock();
-    if (block == -1) return false;
+int FileSystem::append(int handle, std::string_view data) {
+    return writeHandle(handle, 0, data, WRITE_APPEND);
+}
 
-    // ļ
-    DirEntry newFile;
-    newFile.name = fileName;
-    newFile.isDirectory = false;
-    newFile.startBlock = block;
-    newFile.size = 0;
+FileWriter::FileWriter(FileSystem& fs, const std::string& path, size_t chunkBytes)
+    : fs(fs), handle(fs.open(path)), chunkBytes(chunkBytes ? chunkBytes : fs.getBlockSize()), failed(false) {}
 
-    parent->children[fileName] = newFile;
-    return true;
+FileWriter::~FileWriter() {
+    close();
 }
 
-bool FileSystem::openFile(const std::string& path) {
-    DirEntry* file = nullptr;
-    if (!findEntry(path, &file, nullptr) || !file || file->isDirectory) {
+// Ȱѻ岹һ׷ӵݵֱ׷ӣ
+bool FileWriter::write(std::string_view data) {
+    if (handle < 0 || failed) {
         return false;
     }
+    if (!pending.empty()) {
+        size_t n = std::min(data.size(), chunkBytes - pending.size());
+        pending.append(data.data(), n);
+        data.remove_prefix(n);
+        if (pending.size() < chunkBytes) {
+            return true;
+        }
+        if (!flush()) {
+            return false;
+        }
+    }
 
-    openFiles[file->startBlock] = true;
+    size_t whole = data.size() - data.size() % chunkBytes;
+    if (whole > 0) {
+        if (fs.append(handle, data.substr(0, whole)) != static_cast<int>(whole)) {
+            failed = true;
+            return false;
+        }
+        data.remove_prefix(whole);
+    }
+    pending.assign(data.data(), data.size());
     return true;
 }
 
-bool FileSystem::closeFile(const std::string& path) {
-    DirEntry* file = nullptr;
-    if (!findEntry(path, &file, nullptr) || !file || file->isDirectory) {
+bool FileWriter::flush() {
+    if (handle < 0 || failed) {
         return false;
     }
-
-    openFiles.erase(file->startBlock);
+    if (pending.empty()) {
+        return true;
+    }
+    if (fs.append(handle, pending) != static_cast<int>(pending.size())) {
+        failed = true;
+        return false;
+    }
+    pending.clear();
     return true;
 }
 
-bool FileSystem::writeFile(const std::string& path, const std::string& data) {
-    DirEntry* file = nullptr;
-    if (!findEntry(path, &file, nullptr) || !file || file->isDirectory) {
+bool FileWriter::close() {
+    if (handle < 0) {
         return false;
     }
+    bool ok = flush();
+    fs.close(handle);
+    handle = -1;
+    return ok;
+}
 
-    // ļǷ
-    if (openFiles.find(file->startBlock) == openFiles.end()) {
-        return false;
+// 
+std::unique_ptr<Snapshot> FileSystem::snapshot() {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    uint32_t epoch = inodes.currentEpoch();
+    std::unique_ptr<Snapshot> snap(new Snapshot(this, epoch, inodes.snapshot()));
+    std::lock_guard<std::mutex> guard(snapLock);
+    snapshots.push_back(snap.get());
+    return snap;
+}
+
+// ͷź󣬲ٱκοõĿ黹
+void FileSystem::releaseSnapshot(Snapshot* snap) {
+    std::shared_lock<std::shared_mutex> tree(treeLock);
+    std::lock_guard<std::mutex> lock(snapLock);
+    auto found = std::find(snapshots.begin(), snapshots.end(), snap);
+    if (found == snapshots.end()) {
+        return; // ѾʧЧ
     }
+    snapshots.erase(found);
+    for (size_t i = heldChains.size(); i-- > 0;) {
+        if (!heldBySnapshot(heldChains[i].birth, heldChains[i].death)) {
+            freeHeldChain(i);
+        }
+    }
+}
 
-    // ͷԭп
-    freeBlockChain(file->startBlock);
+// 滻ǰпʧЧڽеĿնꣻ֮ûпգյĿȫ黹
+void FileSystem::detachSnapshots() {
+    std::lock_guard<std::mutex> lock(snapLock);
+    for (Snapshot* snap : snapshots) {
+        std::unique_lock<std::shared_mutex> guard(snap->lock);
+        snap->fs = nullptr;
+        snap->fileMaps.clear();
+    }
+    snapshots.clear();
+    for (size_t i = heldChains.size(); i-- > 0;) {
+        freeHeldChain(i);
+    }
+}
 
-    int size = data.size();
-    int blocksNeeded = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+Snapshot::Snapshot(FileSystem* fs, uint32_t epoch, InodeSnapshot&& inodes)
+    : fs(fs), epoch(epoch), inodes(std::move(inodes)) {}
 
-    int prevBlock = -1;
-    int firstBlock = -1;
+Snapshot::~Snapshot() {
+    FileSystem* owner;
+    {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        owner = fs;
+    }
+    if (owner) {
+        owner->releaseSnapshot(this);
+    }
+}
 
-    // ¿
-    for (int i = 0; i < blocksNeeded; i++) {
-        int block = allocateBlock();
-        if (block == -1) {
-            // ʧܣͷѷ
-            if (firstBlock != -1) freeBlockChain(firstBlock);
-            return false;
+// ӸĿ¼·𼶲
+bool Snapshot::findEntry(std::string_view path, uint32_t* ino) const {
+    uint32_t cur = ROOT_INODE;
+    size_t pos = 0;
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos) {
+            end = path.size();
         }
+        std::string_view name = path.substr(pos, end - pos);
+        pos = end + 1;
 
-        if (i == 0) {
-            firstBlock = block;
+        if (name.empty() || name == ".") {
+            continue;
         }
-
-        if (prevBlock != -1) {
-            fat[prevBlock] = block;
+        if (name == "..") {
+            if (inodes[cur].parent != NO_INODE) {
+                cur = inodes[cur].parent;
+            }
+            continue;
         }
-
-        // 
-        int offset = i * BLOCK_SIZE;
-        int bytesToCopy = std::min(BLOCK_SIZE, size - offset);
-        memcpy(memory + block * BLOCK_SIZE, data.data() + offset, bytesToCopy);
-
-        prevBlock = block;
+        if (!inodes[cur].isDirectory) {
+            return false;
+        }
+        uint32_t child = inodes.find(cur, name);
+        if (child == NO_INODE) {
+            return false;
+        }
+        cur = child;
     }
-
-    // ļϢ
-    file->startBlock = firstBlock;
-    file->size = size;
-    fat[prevBlock] = 0xFFFF; // 
-
+    *ino = cur;
     return true;
 }
 
-std::string FileSystem::readFile(const std::string& path, int size) {
-    DirEntry* file = nullptr;
-    if (!findEntry(path, &file, nullptr) || !file || file->isDirectory) {
-        return "";
+// ļαʱĴСֻߵһ飺ĩFATܱ֮д
+// ĺڿͷǰ䣻lock
+FileMap& Snapshot::fileMap(uint32_t ino) {
+    std::lock_guard<std::mutex> guard(mapLock);
+    auto found = fileMaps.find(ino);
+    if (found != fileMaps.end()) {
+        return found->second;
     }
 
-    // ļǷ
-    if (openFiles.find(file->startBlock) == openFiles.end()) {
-        return "";
+    FileMap& map = fileMaps[ino];
+    const Inode& file = inodes[ino];
+    if (file.startBlock < 0) {
+        return map;
     }
+    uint64_t blocks = std::max<uint64_t>((FileSystem::storedBytes(file) + fs->blockSize - 1) / fs->blockSize, 1);
+    fs->chainExtents(static_cast<uint32_t>(file.startBlock), blocks, map.extents);
+    fs->buildSeekIndex(map);
+    fs->loadChunkTable(map, file);
+    return map;
+}
 
-    if (size == -1 || size > file->size) {
-        size = file->size;
+std::vector<std::string> Snapshot::listDir(const std::string& path) {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    std::vector<std::string> result;
+    uint32_t target = NO_INODE;
+    if (!fs || !findEntry(path, &target) || !inodes[target].isDirectory) {
+        result.push_back("Invalid directory: " + path);
+        return result;
     }
+    for (uint32_t child = inodes[target].firstChild; child != NO_INODE; child = inodes[child].nextSibling) {
+        std::string line(inodes[child].isDirectory ? "[DIR] " : "[FILE] ");
+        line += inodes.name(child);
+        result.push_back(std::move(line));
+    }
+    return result;
+}
 
-    std::string content;
-    int block = file->startBlock;
-    int bytesRead = 0;
-
-    while (block != 0xFFFF && bytesRead < size) {
-        int offset = block * BLOCK_SIZE;
-        int bytesToRead = std::min(BLOCK_SIZE, size - bytesRead);
-
-        content.append(memory + offset, bytesToRead);
-        bytesRead += bytesToRead;
-        block = fat[block];
+std::string Snapshot::readFile(const std::string& path) {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    uint32_t ino = NO_INODE;
+    if (!fs || !findEntry(path, &ino) || inodes[ino].isDirectory) {
+        return "";
+    }
+    const Inode& file = inodes[ino];
+    if (file.startBlock == INLINE_BLOCK) {
+        return std::string(file.inlineData, file.size);
     }
 
+    std::string content(file.size, '\0');
+    FilePos pos = { 0, 0 };
+    if (file.compressed) {
+        fs->readCompressed(fileMap(ino), file, 0, &content[0], content.size(), pos);
+    }
+    else {
+        fs->readData(fileMap(ino), 0, &content[0], content.size(), pos);
+    }
     return content;
 }
 
-bool FileSystem::deleteFile(const std::string& path) {
-    DirEntry* file = nullptr;
-    DirEntry* parent = nullptr;
-
-    if (!findEntry(path, &file, &parent) || !file || file->isDirectory) {
-        return false;
+int Snapshot::pread(const std::string& path, int offset, int len, char* buf) {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    uint32_t ino = NO_INODE;
+    if (offset < 0 || len < 0 || !fs || !findEntry(path, &ino) || inodes[ino].isDirectory) {
+        return -1;
+    }
+    const Inode& file = inodes[ino];
+    if (offset >= file.size) {
+        return 0;
+    }
+    len = std::min(len, file.size - offset);
+    if (file.startBlock == INLINE_BLOCK) {
+        memcpy(buf, file.inlineData + offset, len);
+        return len;
     }
 
-    // ļǷ
-    if (openFiles.find(file->startBlock) != openFiles.end()) {
-        return false;
+    FilePos pos = { 0, 0 };
+    if (file.compressed) {
+        fs->readCompressed(fileMap(ino), file, offset, buf, len, pos);
+    }
+    else {
+        fs->readData(fileMap(ino), offset, buf, len, pos);
     }
+    return len;
+}
 
-    // ͷݿ
-    freeBlockChain(file->startBlock);
+// ؽԪλͼFATֻļĿͬ
+// ݿδӻಿգļϵͳ֧ʱΪϡļ
+bool Snapshot::saveToDisk(const std::string& filename) {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    if (!fs) return false;
+
+    // ܸǻԼľĿ¼ռʱóúÿʧЧһ
+    for (;;) {
+        std::shared_lock<std::shared_mutex> tree(fs->treeLock, std::try_to_lock);
+        if (tree.owns_lock()) {
+            if (filename == fs->savedPath || filename == fs->imagePath) return false;
+            break;
+        }
+        guard.unlock();
+        std::this_thread::yield();
+        guard.lock();
+        if (!fs) return false;
+    }
 
-    // ӸĿ¼ɾ
-    if (parent) {
-        parent->children.erase(file->name);
+    uint32_t blockSize = fs->blockSize;
+    uint32_t blockCount = fs->blockCount;
+    SuperBlock sb = FileSystem::makeSuperBlock(blockSize, blockCount);
+    std::vector<char> meta(uint64_t(sb.metaBlocks) * blockSize, 0);
+    uint8_t* bits = reinterpret_cast<uint8_t*>(meta.data() + sb.bitmapOffset);
+    uint32_t* table = reinterpret_cast<uint32_t*>(meta.data() + sb.fatOffset);
+    for (uint32_t i = 0; i < sb.metaBlocks; i++) {
+        bits[i / 8] |= (1 << (i % 8));
     }
 
+    std::string temp = filename + ".tmp";
+    std::ofstream ofs(temp, std::ios::binary | std::ios::trunc);
+    if (!ofs) return false;
+
+    uint64_t used = sb.metaBlocks;
+    std::vector<char> chunk(std::max<uint64_t>(blockSize, 1 << 20));
+    for (uint32_t ino = 0; ino < inodes.size(); ino++) {
+        const Inode& file = inodes[ino];
+        if (!file.inUse || file.isDirectory || file.startBlock < 0) continue;
+        // ȥغ󼸸ļܹͬһֻһ
+        if (bits[file.startBlock / 8] & (1 << (file.startBlock % 8))) continue;
+
+        const FileMap& map = fileMap(ino);
+        for (size_t i = 0; i < map.extents.size(); i++) {
+            const Extent& e = map.extents[i];
+            uint32_t last = e.start + e.count - 1;
+            for (uint32_t b = e.start; b <= last; b++) {
+                bits[b / 8] |= (1 << (b % 8));
+                table[b] = (b < last) ? b + 1 : (i + 1 < map.extents.size()) ? map.extents[i + 1].start : FAT_EOC;
+            }
+            used += e.count;
+
+            uint64_t offset = uint64_t(e.start) * blockSize;
+            uint64_t end = uint64_t(e.start + e.count) * blockSize;
+            ofs.seekp(offset);
+            while (offset < end) {
+                uint64_t n = std::min<uint64_t>(chunk.size(), end - offset);
+                fs->device->read(offset, chunk.data(), n);
+                ofs.write(chunk.data(), n);
+                offset += n;
+            }
+        }
+    }
+    ofs.seekp(sb.inodeOffset);
+    sb.inodeBytes = inodes.save(ofs);
+    sb.freeBlocks = blockCount - used;
+    memcpy(meta.data(), &sb, sizeof(sb));
+    ofs.seekp(0);
+    ofs.write(meta.data(), meta.size());
+    ofs.close();
+    if (!ofs) {
+        std::remove(temp.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(filename.c_str());
+#endif
+    if (std::rename(temp.c_str(), filename.c_str()) != 0) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    std::remove((filename + ".journal").c_str());
     return true;
 }
\ No newline at end of file
@@ -2,58 +2,453 @@
 #pragma once
 #include <vector>
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <string_view>
 #include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "BlockAllocator.h"
+#include "InodeTable.h"
+#include "MappedFile.h"
+#include "BlockDevice.h"
+#include "DirtyMap.h"
+#include "Journal.h"
+#include "ContentHash.h"
+#include "LzCodec.h"
 
-const int BLOCK_SIZE = 512;      // С
-const int BLOCK_COUNT = 1024;    // ܿ
-const int FAT_ENTRY_COUNT = BLOCK_COUNT;
-const int BITMAP_SIZE = (BLOCK_COUNT + 7) / 8; // λͼֽ
+const uint32_t MIN_BLOCK_SIZE = 512;            // СС
+const uint32_t MAX_BLOCK_SIZE = 64 * 1024;      // С
+const uint32_t MAX_BLOCK_COUNT = 0x7FFFFFFF;    // ܷŽint
+const uint32_t DEFAULT_BLOCK_SIZE = 512;        // ĬϿС
+const uint32_t DEFAULT_BLOCK_COUNT = 1024;      // Ĭܿ
 
-struct DirEntry {
-    std::string name;
-    bool isDirectory;
-    int startBlock;
-    int size;
-    std::map<std::string, DirEntry> children; // Ŀ¼/ļ
+const uint32_t FAT_FREE = 0;                    // FAT
+const uint32_t FAT_EOC = 0xFFFFFFFF;            // ļ
+
+const uint32_t FILE_LOCK_STRIPES = 64;          // ļдĸinodeȡģ
+const uint64_t READAHEAD_MIN_BYTES = 128 << 10; // ʼ˳ʱԤ
+const uint64_t READAHEAD_MAX_BYTES = 4 << 20;   // Ԥڵޣ1/4
+const uint64_t WRITE_BEHIND_BYTES = 4 << 20;    // ˳дܹôдĿǰд
+const uint32_t COMPRESS_CHUNK_BYTES = 16 << 10; // ѹļôһηֱѹʱֻѹ漰Ķ
+
+const uint32_t FS_MAGIC = 0x31534653;           // "FSS1"
+const uint32_t FS_VERSION = 10;
+
+// : λھ, ¼ʽʱȷļβ
+// ļ: [][λͼ][FAT][ݿ...][inode]ǰ沿ڴеľֽͬ
+struct SuperBlock {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t blockSize;      // С
+    uint32_t blockCount;     // ܿ
+    uint64_t bitmapOffset;   // λͼֽƫ
+    uint64_t bitmapBytes;    // λͼֽ (64λֶ)
+    uint64_t fatOffset;      // FATֽƫ
+    uint32_t metaBlocks;     // ԪռõĿ
+    uint32_t journalEpoch;   // ÿα1־ֻͬһԪľЧ
+    uint64_t inodeOffset;    // inodeֽƫƣһݿ֮
+    uint64_t inodeBytes;     // inodeֽʱ
+    uint64_t freeBlocks;     // пʱ£ʱλͼΪ׼
+    uint32_t heldChain;      // ֻõĿβӳɵһղرʱͷ
+};
+
+// ļαһηļʱFAT
+struct FileMap {
+    std::vector<Extent> extents;              // ļڵ
+    // εʼֽƫƣfileMapαʱһ
+    // ׷ӻضʱͬ޸ģ(дơǨ)ʱؽ
+    std::vector<uint64_t> seekIndex;
+    std::vector<uint32_t> chunkEnds;          // ѹļεѹڿϵĽƫ
+    uint64_t chunkToken = 0;                  // ѹļݵıţÿһλºţѹ水
+};
+
+// ļڵλã±꼰ļеʼֽƫ
+struct FilePos {
+    size_t extent;
+    uint64_t extentOffset;
+};
+
+// дλ
+enum WriteMode {
+    WRITE_AT,                // ߸ƫ
+    WRITE_CURSOR,            // Ķдλãдƽ
+    WRITE_APPEND,            // ļĩβ
+};
+
+// ļ
+struct FileHandle {
+    uint32_t ino;            // ѽinodeţвλΪNO_INODE
+    uint64_t cursor;         // дλ
+    FilePos pos;             // ϴηʽʱڵ
+    uint32_t generation;     // posӦα汾
+    // ϵ˳д⣬ֻʾ
+    uint64_t readEnd;        // ϴζλã´δ˳
+    uint64_t aheadEnd;       // Ԥλ
+    uint64_t window;         // Ԥֽ0ʾ˳
+    uint64_t writeEnd;       // ϴдλ
+    uint64_t writtenBack;    // ˳дʱǰдصλ
+};
+
+// һļ
+struct DataSpan {
+    const char* data;
+    size_t len;
+};
+
+// 㿽Լspansָļڵڴ棬ڴӳľĻ建棻
+// ڼݱЧҲ䣺ԼĿ¼͸ļĶϻסڵĻ飬
+// ĶĿ¼͸ļĲҪԼͷţ˳Լ߳ͷǰٵFileSystem
+class ReadLease {
+private:
+    friend class FileSystem;
+    std::shared_lock<std::shared_mutex> tree;
+    std::shared_lock<std::shared_mutex> file;
+    std::vector<DataSpan> parts;
+    FileDevice* device;                              // ס豸
+    std::vector<uint32_t> pinned;                    // סĿ
+    std::vector<std::unique_ptr<char[]>> copies;     // סʱƳ
+
+    void add(const char* data, size_t len);
+
+public:
+    ReadLease() : device(nullptr) {}
+    ~ReadLease() { release(); }
+    ReadLease(const ReadLease&) = delete;
+    ReadLease& operator=(const ReadLease&) = delete;
+
+    const std::vector<DataSpan>& spans() const { return parts; }
+    uint64_t size() const;
+    void release();
+};
+
+// ȥصļֻͳƿȥغwriteFileд롢Ųinodeļ
+// ȥر = bytesWritten / (bytesWritten - bytesShared)
+struct DedupStats {
+    uint64_t filesWritten;   // дļ
+    uint64_t bytesWritten;   // дֽ
+    uint64_t filesShared;    // пֱͬӹõļ
+    uint64_t bytesShared;    // ʡµֽ
+    uint64_t collisions;     // ָͬݲͬĴ
+    uint64_t hashNanos;      // ָƵĺʱ
+    uint64_t verifyNanos;    // ָкֽڱȽϵĺʱ
+};
+
+// ļûǼָĿ
+struct SharedChain {
+    uint64_t hash;           // ָƣغŷֹõĿûָƣ
+    uint64_t bytes;          // ֽ
+    uint32_t refs;           // ļ
+    uint32_t birth;          // ʱļԪļԪ
+};
+
+// Ƭ̶ȣֻͳռļ
+// score = (extents - files) / (blocks - files)ļǰڵ鲻ı0ʾȫ
+struct FragmentationStats {
+    uint64_t files;              // ռļ
+    uint64_t blocks;             // ЩļĿ
+    uint64_t extents;            // Щļ
+    uint64_t fragmentedFiles;    // ֹһεļ
+    double score;
 };
 
+// һƬĽ
+struct DefragProgress {
+    uint64_t filesScanned;       // ռļ߳ʹõ
+    uint64_t filesMoved;         // ᵽռļ
+    uint64_t blocksMoved;        // ᶯĿ
+    uint64_t filesSkipped;       // ûаļ߳ʹãļչÿҲĿռ
+    bool passDone;               // inodeѿһ飬´δͷʼ
+};
+
+// ʹáֻõһ
+struct HeldChain {
+    uint32_t start;
+    uint32_t last;
+    uint32_t birth;          // ʱļԪ
+    uint32_t death;          // ʱļԪԪ[birth, death)ڵĿ
+};
+
+class FileSystem;
+
+// ĳһʱ̵ֻգFileSystem::snapshotֻinodeҳָ룬Ƽ¼ݿ
+// ֮ĸĶд¸Ƶinodeҳ·Ŀϣտݲ䣻ղӻ
+// ·ӸĿ¼𡣾ʽ¼ػʧЧؿ
+class Snapshot {
+private:
+    friend class FileSystem;
+    FileSystem* fs;                  // ʧЧΪnullptr
+    uint32_t epoch;                  // ʱinodeļԪ
+    InodeSnapshot inodes;
+    std::shared_mutex lock;          // ʱʧЧʱռ
+    std::mutex mapLock;              // fileMapsĲҺͲ
+    std::unordered_map<uint32_t, FileMap> fileMaps;
+
+    Snapshot(FileSystem* fs, uint32_t epoch, InodeSnapshot&& inodes);
+    bool findEntry(std::string_view path, uint32_t* ino) const;
+    FileMap& fileMap(uint32_t ino);
+
+public:
+    ~Snapshot();
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    std::vector<std::string> listDir(const std::string& path = "/");
+    std::string readFile(const std::string& path);
+    // ļoffsetlenֽڣضֽļʱ-1
+    int pread(const std::string& path, int offset, int len, char* buf);
+    // дһľļһأдͬʱճд
+    bool saveToDisk(const std::string& filename);
+};
+
+// вɶ߳ͬʱã·ҺͲͬļĶдִУ
+// ĶĿ¼ĲԼʽ桢֮以മ
 class FileSystem {
 private:
-    char* memory;                // ڴļϵͳռ
+    friend class Snapshot;
+    uint32_t blockSize;          // С
+    uint32_t blockCount;         // ܿ
+    char* memory;                // ڴеĲ֣ڴӳʱָļֻԪ
+    MappedFile image;            // ӳľļ
+    std::string imagePath;       // ӳԿ豸ʽ򿪵ľļ
+    std::unique_ptr<BlockDevice> device; // ݿĶд
+    FileDevice* fileDevice;      // ʱdeviceݿ龭建дļΪ
+    std::string savedPath;       // 뱾ֻdirtyBlocksľļձʾ´
+    DirtyMap dirtyBlocks;        // ϴαĶĿ飬ԪڵĿ
+    Journal journal;             // savedPathԵԤд־δʱر
+    SuperBlock* super;           // 
     uint8_t* bitmap;             // пλͼ
-    uint16_t* fat;               // FAT
-    DirEntry root;               // Ŀ¼
-    DirEntry* currentDir;        // ǰĿ¼
-    std::map<int, bool> openFiles; // ļ: <ʼ, Ƿ>
+    uint32_t* fat;               // FAT
+    BlockAllocator allocator;    // 黮ֵĿпԴ
+    std::atomic<bool> seekIndexEnabled; // ʱǷʹβ
+    InodeTable inodes;           // Ŀ¼
+    std::unordered_map<uint32_t, FileMap> fileMaps; // inode -> α
+    uint32_t currentDir;         // ǰĿ¼
+    std::vector<FileHandle> handles; // ļ±
+    std::vector<int> freeHandles;    // еľ
+    std::vector<Snapshot*> snapshots;    // ЧĿ
+    std::vector<HeldChain> heldChains;   // ֻõĿsuper->heldChainϵ˳
+    std::atomic<bool> dedupEnabled;      // writeFileǷͬĿ
+    std::unordered_map<uint64_t, uint32_t> dedupIndex;      // ָ -> ׿
+    std::unordered_map<uint32_t, SharedChain> sharedChains; // ׿ -> üֻһļռĿڱ
+    DedupStats dedupCounters;
+    uint32_t defragCursor;               // Ƭ´δinodeŽſ
+
+    // ˳treeLock -> ļ -> ĻЩ֮snapLockⲻǶ
+    mutable std::shared_mutex treeLock;  // Ŀ¼;Ŀ¼ʽʱռ
+    std::shared_mutex fileLocks[FILE_LOCK_STRIPES]; // ļݡСαдռ
+    std::mutex dirtyLock;        // dirtyBlocksinode
+    std::mutex mapLock;          // fileMapsĲҺͲ
+    std::mutex handleLock;       // ļ
+    std::mutex journalLock;      // ־
+    std::mutex snapLock;         // snapshotsheldChainssuper->heldChainڿȡdirtyLock
+    std::mutex dedupLock;        // dedupIndexsharedChainsdedupCountersȽʱһֱ
+    std::mutex defragLock;       // defragCursorʱһֱУtreeLock֮ǰȡ
 
     // 
-    int allocateBlock();
+    static bool validGeometry(uint32_t blockSize, uint32_t blockCount);
+    static SuperBlock makeSuperBlock(uint32_t blockSize, uint32_t blockCount);
+    bool setGeometry(uint32_t blockSize, uint32_t blockCount);
+    void attachVolume();
+    void attachAllocator();
+    void releaseVolume();
+    uint64_t volumeBytes() const { return uint64_t(blockSize) * blockCount; }
+    static bool readSuperBlock(std::istream& is, SuperBlock& sb);
+    static void redoCheckpoint(const std::string& filename, const JournalScan& scan);
+    void writeVolume(std::ostream& os);
+    void resetVolume();
+    void saveVolume(const std::string& filename);
+    bool loadVolume(const std::string& filename, JournalScan& scan);
+    bool saveChanges(const std::string& filename);
+    void markBytes(uint64_t offset, uint64_t len);
+    void markBitmap(uint32_t first, uint32_t count);
+    void markFat(uint32_t first, uint32_t count);
+    void touchInode(uint32_t ino);
+    std::shared_mutex& fileLock(uint32_t ino) { return fileLocks[ino % FILE_LOCK_STRIPES]; }
+    std::string pathOf(uint32_t ino) const;
+    bool logPath(uint8_t type, uint32_t ino);
+    void replayJournal(const std::vector<JournalEntry>& entries);
+    bool allocateExtents(uint32_t blocks, std::vector<Extent>& extents);
+    void linkExtents(const std::vector<Extent>& extents);
     void freeBlockChain(int startBlock);
-    bool findEntry(const std::string& path, DirEntry** entry, DirEntry** parent);
-    void serializeDir(std::ofstream& ofs, DirEntry* dir);
-    void deserializeDir(std::ifstream& ifs, DirEntry* dir);
+    void chainExtents(uint32_t start, uint64_t blocks, std::vector<Extent>& extents) const;
+    bool chainEquals(uint32_t start, std::string_view data);
+    uint32_t findDuplicate(uint64_t hash, uint64_t hashNanos, std::string_view data, uint32_t& birth);
+    void indexChain(uint32_t start, uint64_t hash, uint64_t bytes, uint32_t birth);
+    uint32_t chainRefs(uint32_t start);
+    bool chainEntry(uint32_t start, SharedChain& out);
+    bool releaseChainRef(uint32_t start);
+    bool chainShared(uint32_t ino);
+    void rebuildSharedChains();
+    bool heldBySnapshot(uint32_t birth, uint32_t death) const;
+    bool chainCaptured(uint32_t ino);
+    void holdChain(uint32_t start, uint32_t last, uint32_t birth);
+    void freeHeldChain(size_t i);
+    void dropChain(uint32_t ino);
+    bool unshareChain(uint32_t ino, FilePos& pos);
+    void switchChain(uint32_t ino, std::vector<Extent>& extents, FilePos& pos);
+    bool relocateChain(uint32_t ino);
+    void releaseSnapshot(Snapshot* snap);
+    void detachSnapshots();
+    bool extendFile(uint32_t ino, uint32_t blocks);
+    void trimChain(uint32_t ino, uint32_t blocks, FilePos& pos);
+    void chainRuns(uint32_t start, uint32_t& blocks, uint32_t& runs) const;
+    uint32_t fileBlocks(const FileMap& map) const;
+    void buildSeekIndex(FileMap& map);
+    void seekExtent(FileMap& map, uint64_t offset, FilePos& pos);
+    void readData(FileMap& map, uint64_t offset, char* buf, uint64_t len, FilePos& pos);
+    void writeData(FileMap& map, uint64_t offset, const char* data, uint64_t len, FilePos& pos);
+    bool getHandle(int handle, FileHandle& out);
+    void updateHandle(int handle, const FileHandle& h, uint64_t advance);
+    FilePos& handlePos(FileHandle& h);
+    void rangeBlocks(FileMap& map, uint64_t from, uint64_t to, FilePos pos, std::vector<uint32_t>& out);
+    uint64_t streamLimit(uint64_t bytes) const;
+    void readAhead(FileHandle& h, FileMap& map, uint64_t offset, uint64_t len);
+    void writeBehind(FileHandle& h, FileMap& map, uint64_t offset, uint64_t len);
+    int readHandle(int handle, int offset, int len, char* buf, bool atCursor);
+    int writeHandle(int handle, int offset, std::string_view data, WriteMode mode);
+    bool writeLocked(uint32_t ino, uint64_t offset, std::string_view data, FilePos& pos);
+    bool replaceContent(uint32_t ino, std::string_view data);
+    bool moveInlineToBlocks(uint32_t ino, FilePos& pos);
+    static uint64_t storedBytes(const Inode& file);
+    static void encodeChunks(std::string_view data, uint64_t base, std::string& out, std::vector<uint32_t>& ends);
+    void loadChunkTable(FileMap& map, const Inode& file);
+    void readCompressed(FileMap& map, const Inode& file, uint64_t offset, char* buf, uint64_t len, FilePos& pos);
+    bool writeCompressed(uint32_t ino, uint64_t offset, std::string_view data, FilePos& pos);
+    void closeAllHandles();
+    FileMap& fileMap(uint32_t ino);
+    static void splitPath(std::string_view path, std::string_view& parentPath, std::string_view& name);
+    bool findEntry(std::string_view path, uint32_t* ino, uint32_t* parent);
+    void resetTree();
 
 public:
-    FileSystem();
+    FileSystem(uint32_t blockSize = DEFAULT_BLOCK_SIZE, uint32_t blockCount = DEFAULT_BLOCK_COUNT);
     ~FileSystem();
 
+    // 
+    uint32_t getBlockSize() const { return blockSize; }
+    uint32_t getBlockCount() const { return blockCount; }
+    // 顢λͼFATռõĿЩ鲻ָļ
+    uint32_t getMetaBlocks() const { return super->metaBlocks; }
+    // λͼиÿǷ
+    bool isBlockUsed(uint32_t block) const { return (bitmap[block / 8] >> (block % 8)) & 1; }
+    // ɷļĿпɨλͼ߳ڷʱֻǽֵ
+    uint64_t freeBlocks() const { return allocator.freeCount(); }
+    uint64_t metadataMemory() const {
+        std::shared_lock<std::shared_mutex> lock(treeLock);
+        return inodes.memoryUsage();
+    }
+
+    // رպ˻ΪͷαڶԱ
+    void setSeekIndex(bool enabled) { seekIndexEnabled = enabled; }
+
+    // ȥأwriteFileָƣļȫͬʱĿ䣻
+    // õĿһļдǰһݡֻļȽϣFATĺ̰¼鲻ܹϣ
+    // ͬļκο飬ȥҪFAT֮ӴüĿӳ䣬ϸʽ
+    void setDedup(bool enabled) { dedupEnabled = enabled; }
+    bool isDedup() const { return dedupEnabled; }
+    DedupStats dedupStats();
+
+    // ƬɶɵļƵĿпռ䣬
+    // һļʱռҪôҪôÿεôϴͣµinodeţ
+    // budgetMicros΢ͷأһļꣻʹûļչÿļһֲ
+    DefragProgress defragment(uint64_t budgetMicros);
+    // ļαƬ̶ȣʱļܿ
+    FragmentationStats fragmentation();
+
+    // ֻգʱinodeҳȣݣͷźֻõĿ黹
+    std::unique_ptr<Snapshot> snapshot();
+
     // ̲
     void format();
+    bool format(uint32_t blockSize, uint32_t blockCount);
     void saveToDisk(const std::string& filename);
     void loadFromDisk(const std::string& filename);
+    // 浽ϴα桢ػӳͬһļʱֻдظĶĿinode
+    // ֱӳ侵ļΪݿڷʱŵ
+    bool mapImage(const std::string& filename);
+    bool isMapped() const { return image.isOpen(); }
+    // Կ豸ʽ򿪾񣺳顢λͼFATפڴ棬ݿ龭建水д
+    // ԱڴöࣻռcacheBytesֽڣ̭򱣴ʱд飻
+    // ȱĶдؾbackendѡ첽I/Oύ
+    bool openImage(const std::string& filename, uint64_t cacheBytes = DEFAULT_CACHE_BYTES, IoBackend backend = IO_AUTO);
+    // ļֱӸʽһ¾Կ豸ʽ򿪣ڴ
+    bool createImage(const std::string& filename, uint32_t blockSize, uint32_t blockCount,
+        uint64_t cacheBytes = DEFAULT_CACHE_BYTES, IoBackend backend = IO_AUTO);
+    bool isCached() const { return fileDevice != nullptr; }
+    // ʵʹõ첽I/O棬ģʽΪմ
+    const char* ioEngine() const { return fileDevice ? fileDevice->engineName() : ""; }
+    // ĻģʽȫΪ0
+    CacheStats cacheStats();
+
+    // Ԥд־ѱľ֮Ŀ¼ļ뾵Ե.journalļ
+    // ÿgroupRecordsһfsyncsaveToDisk㣬ʱԶ־
+    // ӳģʽҳϵͳʱдأ֧־
+    bool enableJournal(uint32_t groupRecords = 64);
+    void disableJournal();
+    bool isJournaled() const { return journal.isOpen(); }
+    // ύδ̵־¼
+    bool sync();
 
     // Ŀ¼
     bool mkdir(const std::string& path);
     bool rmdir(const std::string& path);
     std::vector<std::string> listDir(const std::string& path = "");
     bool changeDir(const std::string& path);
+    bool rename(const std::string& from, const std::string& to);
 
     // ļ
     bool createFile(const std::string& path);
     bool openFile(const std::string& path);
     bool closeFile(const std::string& path);
     bool writeFile(const std::string& path, const std::string& data);
+    // ļĩβԭֻΪݷ
+    bool appendFile(const std::string& path, std::string_view data);
     std::string readFile(const std::string& path, int size = -1);
     bool deleteFile(const std::string& path);
+    // ѹ֮дݰCOMPRESS_CHUNK_BYTESһѹţдһ飻
+    // ʱֻѹ漰ĶΡдмҪڵĶѹļĩβʺдֻ׷ӵļ
+    bool setCompressed(const std::string& path, bool enabled);
+    // ļ߼СڿʵռõֽļռΪ0
+    bool fileSizes(const std::string& path, uint64_t& size, uint64_t& stored);
+
+    // 
+    int open(const std::string& path);
+    bool close(int handle);
+    bool seek(int handle, int offset);
+    std::string read(int handle, int size);
+    int write(int handle, const std::string& data);
+    int pread(int handle, int offset, int len, char* buf);
+    int pwrite(int handle, int offset, const std::string& data);
+    // дļĩβıдλãдֽ
+    int append(int handle, std::string_view data);
+    // Ƶضļ[offset, offset+len)ݾlease.spans()ʣضֽ
+    // leaseԭȳеͷţûжʱκ
+    int readSpans(int handle, int offset, int len, ReadLease& lease);
+};
+
+// ֿдļĩβݷֶνwriteܹchunkBytes׷һΣ
+// ݲͬʱڴcloseʱдʣµ
+class FileWriter {
+private:
+    FileSystem& fs;
+    int handle;
+    std::string pending;     // һ׷ӵ
+    size_t chunkBytes;
+    bool failed;             // һ׷ʧܣ֮д붼ʧ
+
+public:
+    // ѴڵļchunkBytesΪ0ʱȡĿС
+    FileWriter(FileSystem& fs, const std::string& path, size_t chunkBytes = 0);
+    ~FileWriter();
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    bool isOpen() const { return handle >= 0; }
+    bool write(std::string_view data);
+    // ѻе׷ӵļ
+    bool flush();
+    bool close();
 };
\ No newline at end of file
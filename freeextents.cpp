@@ -0,0 +1,92 @@
+// FreeExtents.cpp
+#include "FreeExtents.h"
+
+FreeExtents::FreeExtents() : freeBlocks(0) {}
+
+void FreeExtents::clear() {
+    byStart.clear();
+    bySize.clear();
+    freeBlocks = 0;
+}
+
+void FreeExtents::add(uint32_t start, uint32_t count) {
+    byStart[start] = count;
+    bySize.insert(std::make_pair(count, start));
+    freeBlocks += count;
+}
+
+void FreeExtents::erase(std::map<uint32_t, uint32_t>::iterator it) {
+    bySize.erase(std::make_pair(it->second, it->first));
+    freeBlocks -= it->second;
+    byStart.erase(it);
+}
+
+void FreeExtents::release(uint32_t start, uint32_t count) {
+    if (count == 0) return;
+
+    // һϲ
+    auto next = byStart.find(start + count);
+    if (next != byStart.end()) {
+        count += next->second;
+        erase(next);
+    }
+
+    // ǰһϲ
+    auto prev = byStart.lower_bound(start);
+    if (prev != byStart.begin()) {
+        --prev;
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            count += prev->second;
+            erase(prev);
+        }
+    }
+
+    add(start, count);
+}
+
+uint32_t FreeExtents::runAt(uint32_t start) const {
+    auto it = byStart.upper_bound(start);
+    if (it == byStart.begin()) return 0;
+    --it;
+
+    uint32_t runEnd = it->first + it->second;
+    return start < runEnd ? runEnd - start : 0;
+}
+
+void FreeExtents::reserve(uint32_t start, uint32_t count) {
+    if (count == 0) return;
+
+    // ҵstartĿж
+    auto it = byStart.upper_bound(start);
+    if (it == byStart.begin()) return;
+    --it;
+
+    uint32_t runStart = it->first;
+    uint32_t runEnd = it->first + it->second;
+    if (start + count > runEnd) return;
+
+    // ǰʣಿ
+    erase(it);
+    if (start > runStart) {
+        add(runStart, start - runStart);
+    }
+    if (start + count < runEnd) {
+        add(start + count, runEnd - start - count);
+    }
+}
+
+bool FreeExtents::allocate(uint32_t count, Extent& result) {
+    if (bySize.empty() || count == 0) return false;
+
+    auto fit = bySize.lower_bound(std::make_pair(count, uint32_t(0)));
+    if (fit == bySize.end()) {
+        // û㹻ĶΣȸһ
+        --fit;
+    }
+
+    result.start = fit->second;
+    result.count = fit->first < count ? fit->first : count;
+    reserve(result.start, result.count);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+// FreeExtents.h
+#pragma once
+#include <map>
+#include <set>
+#include <utility>
+#include <cstdint>
+
+// һĿ
+struct Extent {
+    uint32_t start;     // ʼ
+    uint32_t count;     // 
+};
+
+// 
+// ͬʱʼͰ֯е飬طοռ
+class FreeExtents {
+private:
+    std::map<uint32_t, uint32_t> byStart;            // ʼ -> 
+    std::set<std::pair<uint32_t, uint32_t>> bySize;  // (, ʼ)
+    uint64_t freeBlocks;                             // п
+
+    void add(uint32_t start, uint32_t count);
+    void erase(std::map<uint32_t, uint32_t>::iterator it);
+
+public:
+    FreeExtents();
+
+    void clear();
+    uint64_t freeCount() const { return freeBlocks; }
+    // жεĿ
+    uint32_t longestRun() const { return bySize.empty() ? 0 : bySize.rbegin()->first; }
+
+    // ͷһο飬ڿжκϲ
+    void release(uint32_t start, uint32_t count);
+    // startʼеĿstartʱΪ0
+    uint32_t runAt(uint32_t start) const;
+    // ռһ֪еĿ(ĳжεһ)
+    void reserve(uint32_t start, uint32_t count);
+    // 䣺ȡcount̿жΣûȡһ
+    bool allocate(uint32_t count, Extent& result);
+};
\ No newline at end of file
@@ -0,0 +1,418 @@
+// InodeTable.cpp
+#include "InodeTable.h"
+
+// едСһСĶԭд
+static uint64_t inodeCapacityFor(uint64_t inodeCount) { return inodeCount + inodeCount / 2 + 64; }
+static uint64_t nameCapacityFor(uint64_t nameBytes) { return nameBytes + nameBytes / 2 + 1024; }
+
+// дinode¼ҳдλ0Ϳչ
+template <typename PagePtr>
+static uint64_t writeArea(std::ostream& os, const std::vector<PagePtr>& pages, uint32_t inodeCount,
+    const char* names, uint64_t nameBytes) {
+    InodeAreaHeader header;
+    header.inodeCount = inodeCount;
+    header.nameBytes = nameBytes;
+    header.inodeCapacity = inodeCapacityFor(inodeCount);
+    header.nameCapacity = nameCapacityFor(nameBytes);
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (uint32_t first = 0; first < inodeCount; first += INODES_PER_PAGE) {
+        uint32_t n = std::min(INODES_PER_PAGE, inodeCount - first);
+        os.write(reinterpret_cast<const char*>(pages[first / INODES_PER_PAGE]->records), n * sizeof(Inode));
+    }
+    std::vector<char> zeros((header.inodeCapacity - inodeCount) * sizeof(Inode));
+    os.write(zeros.data(), zeros.size());
+    os.write(names, nameBytes);
+    zeros.assign(header.nameCapacity - nameBytes, 0);
+    os.write(zeros.data(), zeros.size());
+    return sizeof(header) + header.inodeCapacity * sizeof(Inode) + header.nameCapacity;
+}
+
+uint32_t InodeSnapshot::find(uint32_t dir, std::string_view name) const {
+    for (uint32_t child = (*this)[dir].firstChild; child != NO_INODE; child = (*this)[child].nextSibling) {
+        if (this->name(child) == name) {
+            return child;
+        }
+    }
+    return NO_INODE;
+}
+
+uint64_t InodeSnapshot::save(std::ostream& os) const {
+    return writeArea(os, pages, inodeCount, names, nameBytes);
+}
+
+InodeTable::InodeTable()
+    : slotCapacity(0), inodeCount(0), epoch(0), deadNameBytes(0),
+      savedInodeCapacity(0), savedNameCapacity(0), savedNameBytes(0), savedHeader() {
+    reset();
+}
+
+// һűݣԪŻűռ
+InodeTable& InodeTable::operator=(InodeTable&& other) {
+    pages = std::move(other.pages);
+    slots = std::move(other.slots);
+    slotCapacity = other.slotCapacity;
+    retired.clear();
+    inodeCount = other.inodeCount;
+    epoch = other.epoch;
+    names = std::move(other.names);
+    freeInodes = std::move(other.freeInodes);
+    deadNameBytes = other.deadNameBytes;
+    index = std::move(other.index);
+    dirty = std::move(other.dirty);
+    savedInodeCapacity = other.savedInodeCapacity;
+    savedNameCapacity = other.savedNameCapacity;
+    savedNameBytes = other.savedNameBytes;
+    savedHeader = other.savedHeader;
+    other.slotCapacity = 0;
+    other.reset();
+    return *this;
+}
+
+void InodeTable::reset() {
+    pages.clear();
+    retired.clear();
+    rebuildSlots(16);
+    inodeCount = 0;
+    names = std::make_shared<std::vector<char>>();
+    freeInodes.clear();
+    deadNameBytes = 0;
+    index.clear();
+    dirty.clear();
+    savedInodeCapacity = 0;
+
+    addPage();
+    inodeCount = 1;
+    Inode& root = edit(ROOT_INODE);
+    root = Inode();
+    root.parent = NO_INODE;
+    root.firstChild = NO_INODE;
+    root.nextSibling = NO_INODE;
+    root.prevSibling = NO_INODE;
+    root.isDirectory = 1;
+    root.inUse = 1;
+    root.startBlock = -1;  // Ŀ¼ʹݿ
+    root.nameOffset = appendName("/");
+    root.nameLength = 1;
+    dirty.resize(1);
+}
+
+// pagesؽҳָ
+void InodeTable::rebuildSlots(size_t capacity) {
+    std::unique_ptr<std::atomic<InodePage*>[]> fresh(new std::atomic<InodePage*>[capacity]);
+    for (size_t i = 0; i < pages.size(); i++) {
+        fresh[i].store(pages[i].get(), std::memory_order_relaxed);
+    }
+    slots.swap(fresh);
+    slotCapacity = capacity;
+}
+
+// ĩβһҳҳָ鰴
+void InodeTable::addPage() {
+    if (pages.size() == slotCapacity) {
+        rebuildSlots(slotCapacity * 2);
+    }
+    std::shared_ptr<InodePage> page = std::make_shared<InodePage>();
+    page->epoch.store(epoch, std::memory_order_relaxed);
+    slots[pages.size()].store(page.get(), std::memory_order_release);
+    pages.push_back(std::move(page));
+}
+
+// ҳϴο֮ǰУնͷʱֱջأһݻ
+// µľҳ´ζռűʱͷţ̴߳ʱܻ
+InodePage* InodeTable::ownPage(uint32_t page) {
+    std::lock_guard<std::mutex> lock(cowLock);
+    InodePage* current = slots[page].load(std::memory_order_relaxed);
+    if (current->epoch.load(std::memory_order_relaxed) == epoch) {
+        return current;
+    }
+    if (pages[page].use_count() == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        current->epoch.store(epoch, std::memory_order_relaxed);
+        return current;
+    }
+
+    std::shared_ptr<InodePage> copy = std::make_shared<InodePage>(*current);
+    copy->epoch.store(epoch, std::memory_order_relaxed);
+    retired.push_back(std::move(pages[page]));
+    pages[page] = copy;
+    slots[page].store(copy.get(), std::memory_order_release);
+    return copy.get();
+}
+
+InodeSnapshot InodeTable::snapshot() {
+    InodeSnapshot snap;
+    snap.pages.assign(pages.begin(), pages.end());
+    snap.nameArea = names;
+    snap.names = names->data();
+    snap.nameBytes = names->size();
+    snap.inodeCount = inodeCount;
+    epoch++;
+    retired.clear();
+    return snap;
+}
+
+// ʱԭݣһ
+uint32_t InodeTable::appendName(std::string_view name) {
+    if (names->size() + name.size() > names->capacity() && names.use_count() > 1) {
+        std::shared_ptr<std::vector<char>> bigger = std::make_shared<std::vector<char>>();
+        bigger->reserve(std::max(names->capacity() * 2, names->size() + name.size()));
+        bigger->assign(names->begin(), names->end());
+        names = std::move(bigger);
+    }
+    uint32_t offset = static_cast<uint32_t>(names->size());
+    names->insert(names->end(), name.begin(), name.end());
+    return offset;
+}
+
+// ֻ׷ӣϵֽڳһʱѹһ
+void InodeTable::dropName(uint32_t ino) {
+    deadNameBytes += (*this)[ino].nameLength;
+    if (deadNameBytes > 4096 && deadNameBytes * 2 > names->size()) {
+        compactNames();
+    }
+}
+
+// ѹһµԭ
+void InodeTable::compactNames() {
+    std::shared_ptr<std::vector<char>> packed = std::make_shared<std::vector<char>>();
+    packed->reserve(names->size() - deadNameBytes);
+    for (uint32_t ino = 0; ino < inodeCount; ino++) {
+        if (!(*this)[ino].inUse) continue;
+        Inode& node = edit(ino);
+        uint32_t offset = static_cast<uint32_t>(packed->size());
+        packed->insert(packed->end(), names->begin() + node.nameOffset,
+            names->begin() + node.nameOffset + node.nameLength);
+        node.nameOffset = offset;
+    }
+    names = std::move(packed);
+    deadNameBytes = 0;
+    savedInodeCapacity = 0; // ֵƫƶ
+}
+
+// ӵĿ¼ĩβ
+void InodeTable::link(uint32_t dir, uint32_t ino) {
+    Inode& d = edit(dir);
+    Inode& node = edit(ino);
+    node.parent = dir;
+    node.nextSibling = NO_INODE;
+    dirty.mark(dir);
+    dirty.mark(ino);
+    if (d.firstChild == NO_INODE) {
+        d.firstChild = ino;
+        node.prevSibling = ino;
+    }
+    else {
+        uint32_t last = (*this)[d.firstChild].prevSibling;
+        edit(last).nextSibling = ino;
+        node.prevSibling = last;
+        edit(d.firstChild).prevSibling = ino;
+        dirty.mark(last);
+        dirty.mark(d.firstChild);
+    }
+}
+
+void InodeTable::unlink(uint32_t ino) {
+    const Inode& node = (*this)[ino];
+    uint32_t first = (*this)[node.parent].firstChild;
+    dirty.mark(ino);
+    dirty.mark(node.parent);
+    if (node.nextSibling != NO_INODE) {
+        edit(node.nextSibling).prevSibling = node.prevSibling;
+        dirty.mark(node.nextSibling);
+    }
+    else {
+        edit(first).prevSibling = node.prevSibling; // ժһ
+        dirty.mark(first);
+    }
+    if (ino == first) {
+        edit(node.parent).firstChild = node.nextSibling;
+    }
+    else {
+        edit(node.prevSibling).nextSibling = node.nextSibling;
+        dirty.mark(node.prevSibling);
+    }
+}
+
+uint32_t InodeTable::create(uint32_t dir, std::string_view name, bool isDirectory) {
+    if (name.size() > MAX_NAME_LENGTH || find(dir, name) != NO_INODE) {
+        return NO_INODE;
+    }
+
+    // ȸÿм¼
+    uint32_t ino;
+    if (!freeInodes.empty()) {
+        ino = freeInodes.back();
+        freeInodes.pop_back();
+    }
+    else {
+        ino = inodeCount;
+        if (ino % INODES_PER_PAGE == 0) {
+            addPage();
+        }
+        inodeCount++;
+        dirty.resize(ino + 1);
+    }
+
+    Inode& node = edit(ino);
+    node = Inode();
+    node.firstChild = NO_INODE;
+    node.nameOffset = appendName(name);
+    node.nameLength = static_cast<uint16_t>(name.size());
+    node.isDirectory = isDirectory ? 1 : 0;
+    node.inUse = 1;
+    node.startBlock = -1;
+    link(dir, ino);
+    index.insert(*this, ino);
+    return ino;
+}
+
+void InodeTable::remove(uint32_t ino) {
+    index.remove(*this, ino);
+    unlink(ino);
+    edit(ino).inUse = 0;
+    dropName(ino);
+    freeInodes.push_back(ino);
+}
+
+bool InodeTable::move(uint32_t ino, uint32_t newDir, std::string_view newName) {
+    if (newName.size() > MAX_NAME_LENGTH) {
+        return false;
+    }
+
+    index.remove(*this, ino);
+    unlink(ino);
+    if (name(ino) != newName) {
+        dropName(ino);
+        uint32_t offset = appendName(newName);  // ѹ׷ӣƫƲЧ
+        Inode& node = edit(ino);
+        node.nameOffset = offset;
+        node.nameLength = static_cast<uint16_t>(newName.size());
+    }
+    link(newDir, ino);
+    index.insert(*this, ino);
+    return true;
+}
+
+uint64_t InodeTable::memoryUsage() const {
+    return pages.size() * sizeof(InodePage) + slotCapacity * sizeof(InodePage*) + names->capacity() +
+        freeInodes.capacity() * sizeof(uint32_t) + index.memoryUsage();
+}
+
+uint64_t InodeTable::inodeCapacity() const {
+    return inodeCapacityFor(inodeCount);
+}
+
+uint64_t InodeTable::nameCapacity() const {
+    return nameCapacityFor(names->size());
+}
+
+uint64_t InodeTable::save(std::ostream& os) const {
+    return writeArea(os, pages, inodeCount, names->data(), names->size());
+}
+
+uint64_t InodeTable::savedAreaBytes() const {
+    return sizeof(InodeAreaHeader) + savedInodeCapacity * sizeof(Inode) + savedNameCapacity;
+}
+
+void InodeTable::markSaved() {
+    savedInodeCapacity = inodeCapacity();
+    savedNameCapacity = nameCapacity();
+    savedNameBytes = names->size();
+    dirty.clear();
+}
+
+bool InodeTable::saveChanges(std::vector<ImageWrite>& out, uint64_t areaOffset) {
+    if (savedInodeCapacity == 0 || inodeCount > savedInodeCapacity || names->size() > savedNameCapacity) {
+        return false;
+    }
+
+    savedHeader = InodeAreaHeader{ inodeCount, names->size(), savedInodeCapacity, savedNameCapacity };
+    out.push_back(ImageWrite{ areaOffset, reinterpret_cast<const char*>(&savedHeader), sizeof(savedHeader) });
+
+    // Ķļ¼дأҳĶΰҳ
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    dirty.runs(runs);
+    for (const auto& run : runs) {
+        uint32_t end = run.first + run.second;
+        for (uint32_t ino = run.first; ino < end;) {
+            uint32_t n = std::min(end, (ino / INODES_PER_PAGE + 1) * INODES_PER_PAGE) - ino;
+            out.push_back(ImageWrite{ areaOffset + sizeof(InodeAreaHeader) + uint64_t(ino) * sizeof(Inode),
+                reinterpret_cast<const char*>(&(*this)[ino]), uint64_t(n) * sizeof(Inode) });
+            ino += n;
+        }
+    }
+
+    // ֻĩβ׷ӣдϴα֮Ĳ
+    if (names->size() > savedNameBytes) {
+        out.push_back(ImageWrite{ areaOffset + sizeof(InodeAreaHeader) + savedInodeCapacity * sizeof(Inode) + savedNameBytes,
+            names->data() + savedNameBytes, names->size() - savedNameBytes });
+    }
+    savedNameBytes = names->size();
+    dirty.clear();
+    return true;
+}
+
+bool InodeTable::load(std::istream& is) {
+    uint64_t base = static_cast<uint64_t>(is.tellg());
+    InodeAreaHeader header;
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    uint64_t count = header.inodeCount;
+    uint64_t nameBytes = header.nameBytes;
+    if (!is || count == 0 || count > NO_INODE || nameBytes > 0xFFFFFFFF ||
+        count > header.inodeCapacity || nameBytes > header.nameCapacity) {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<InodePage>> newPages;
+    for (uint64_t first = 0; first < count && is; first += INODES_PER_PAGE) {
+        newPages.push_back(std::make_shared<InodePage>());
+        newPages.back()->epoch.store(epoch, std::memory_order_relaxed);
+        uint64_t n = std::min<uint64_t>(INODES_PER_PAGE, count - first);
+        is.read(reinterpret_cast<char*>(newPages.back()->records), n * sizeof(Inode));
+    }
+    std::shared_ptr<std::vector<char>> newNames = std::make_shared<std::vector<char>>(nameBytes);
+    is.seekg(base + sizeof(header) + header.inodeCapacity * sizeof(Inode));
+    is.read(newNames->data(), nameBytes);
+    const Inode& root = newPages[0]->records[ROOT_INODE];
+    if (!is || !root.inUse || !root.isDirectory) {
+        return false;
+    }
+
+    pages.swap(newPages);
+    retired.clear();
+    rebuildSlots(std::max<size_t>(pages.size(), 16));
+    inodeCount = static_cast<uint32_t>(count);
+    names = std::move(newNames);
+    freeInodes.clear();
+    deadNameBytes = nameBytes;
+    index.clear();
+    dirty.clear();
+    dirty.resize(inodeCount);
+    savedInodeCapacity = header.inodeCapacity;
+    savedNameCapacity = header.nameCapacity;
+    savedNameBytes = nameBytes;
+
+    // ʱ״̬㣬б͹ϣɼ¼ʱûпգռ
+    for (uint32_t ino = 0; ino < inodeCount; ino++) {
+        Inode& node = edit(ino);
+        node.generation = 0;
+        node.openCount = 0;
+        node.chainEpoch = epoch;
+        if (!node.inUse) {
+            freeInodes.push_back(ino);
+            continue;
+        }
+        if (uint64_t(node.nameOffset) + node.nameLength > nameBytes ||
+            (ino != ROOT_INODE && node.parent >= inodeCount) ||
+            (node.startBlock == INLINE_BLOCK && uint32_t(node.size) > INLINE_DATA_BYTES)) {
+            reset();
+            return false;
+        }
+        deadNameBytes -= node.nameLength;
+        if (ino != ROOT_INODE) {
+            index.insert(*this, ino);
+        }
+    }
+    return true;
+}
\ No newline at end of file
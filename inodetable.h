@@ -0,0 +1,180 @@
+// InodeTable.h
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <string_view>
+#include <iostream>
+#include <cstdint>
+#include "DirIndex.h"
+#include "DirtyMap.h"
+#include "Journal.h"
+
+const uint32_t NO_INODE = 0xFFFFFFFF;           // inode
+const uint32_t ROOT_INODE = 0;                  // Ŀ¼inode
+const uint32_t MAX_NAME_LENGTH = 0xFFFF;        // 󳤶
+const uint32_t INLINE_DATA_BYTES = 56;          // ôļֱӷinode¼
+const int32_t INLINE_BLOCK = -2;                // inode¼ļstartBlock
+const uint32_t INODES_PER_PAGE = 256;           // ÿ¼ҳinode
+
+// inode¼inodeŴһ
+// ͬһĿ¼ֵһprevSiblingָһ
+// ļռ飬startBlockΪ-1СļݷinlineDataռҲռFAT
+// ѹļsizeǽѹĴСϴstoredSizeֽڵѹ
+struct Inode {
+    uint32_t parent;         // Ŀ¼Ŀ¼ΪNO_INODE
+    uint32_t firstChild;     // һ
+    uint32_t nextSibling;    // һ
+    uint32_t prevSibling;    // һ
+    uint32_t nameOffset;     // еƫ
+    uint16_t nameLength;     // ֳ
+    uint8_t isDirectory;
+    uint8_t inUse;           // 0ʾм¼
+    int32_t startBlock;
+    int32_t size;
+    uint32_t generation;     // αؽĴ
+    uint32_t openCount;      // 򿪸ļľ
+    uint32_t chainEpoch;     // ʱinodeĿռԪȵǰԪС˵ܱ
+    uint32_t storedSize;     // ѹļڿϵֽѹݼϿ
+    uint8_t compressed;      // ݰѹţݲѹ
+    uint8_t reserved[3];
+    char inlineData[INLINE_DATA_BYTES];  // startBlockΪINLINE_BLOCKʱǰsizeֽļ
+};
+
+// һҳinode¼ͿչҪĶѱõҳʱȸһݻ
+struct InodePage {
+    Inode records[INODES_PER_PAGE];
+    std::atomic<uint32_t> epoch;     // ҳռʱļԪ
+
+    InodePage() : records(), epoch(0) {}
+    InodePage(const InodePage& other) : epoch(other.epoch.load(std::memory_order_relaxed)) {
+        std::copy(other.records, other.records + INODES_PER_PAGE, records);
+    }
+};
+
+// inodeͷǼ¼
+struct InodeAreaHeader {
+    uint64_t inodeCount;
+    uint64_t nameBytes;
+    uint64_t inodeCapacity;
+    uint64_t nameCapacity;
+};
+
+// inodeĳһʱ̵ֻͼInodeTable::snapshot
+// ¼ҳƼ¼֮ĸĶд¸ƵҳϣӰͼͼؼ
+class InodeSnapshot {
+private:
+    friend class InodeTable;
+    std::vector<std::shared_ptr<const InodePage>> pages;
+    std::shared_ptr<const std::vector<char>> nameArea;
+    const char* names;                   // nameAreaݣֻ׷ӣᶯ
+    uint64_t nameBytes;
+    uint32_t inodeCount;
+
+public:
+    InodeSnapshot() : names(nullptr), nameBytes(0), inodeCount(0) {}
+
+    const Inode& operator[](uint32_t ino) const {
+        return pages[ino / INODES_PER_PAGE]->records[ino % INODES_PER_PAGE];
+    }
+    std::string_view name(uint32_t ino) const {
+        const Inode& node = (*this)[ino];
+        return std::string_view(names + node.nameOffset, node.nameLength);
+    }
+    uint32_t size() const { return inodeCount; }
+    // dirֲңͼûйϣ
+    uint32_t find(uint32_t dir, std::string_view name) const;
+    // InodeTable::saveĸʽд
+    uint64_t save(std::ostream& os) const;
+};
+
+// inodeҳĶ¼ +  + (Ŀ¼, )ϣ
+// ֻü飬ͷĿ¼ʱűһд
+// ֻҳָ룬֮ҳдʱơ¼͸ļļ¼ڶ߳У
+// ɾĿ¼ապͼɵ߶ռű
+class InodeTable {
+private:
+    std::vector<std::shared_ptr<InodePage>> pages;       // ¼ҳinodeŷҳ
+    std::unique_ptr<std::atomic<InodePage*>[]> slots;   // pagesӦдʱƻҳʱ߳ճ
+    size_t slotCapacity;
+    std::vector<std::shared_ptr<InodePage>> retired;     // µľҳܻ߳̿ڶ´ζռʱͷ
+    std::mutex cowLock;                                  // ҳ
+    uint32_t inodeCount;                 // ¼
+    uint32_t epoch;                      // ռԪÿһοռ1
+    std::shared_ptr<std::vector<char>> names;            // ֻĩβ׷ӣʱԭ
+    std::vector<uint32_t> freeInodes;    // еinode
+    uint64_t deadNameBytes;              // ϵֽ
+    DirIndex index;                      // (Ŀ¼, ) -> inode
+    DirtyMap dirty;                      // ϴαĶinode
+    uint64_t savedInodeCapacity;         // inodeܷµļ¼0ʾҪд
+    uint64_t savedNameCapacity;          // inode
+    uint64_t savedNameBytes;             // д뾵
+    InodeAreaHeader savedHeader;         // saveChangesдͷ
+
+    uint32_t appendName(std::string_view name);
+    uint64_t inodeCapacity() const;
+    uint64_t nameCapacity() const;
+    void rebuildSlots(size_t capacity);
+    void addPage();
+    InodePage* ownPage(uint32_t page);
+    void dropName(uint32_t ino);
+    void compactNames();
+    void link(uint32_t dir, uint32_t ino);
+    void unlink(uint32_t ino);
+
+public:
+    InodeTable();
+    InodeTable(const InodeTable&) = delete;
+    InodeTable& operator=(const InodeTable&) = delete;
+    InodeTable& operator=(InodeTable&& other);
+
+    // ֻһյĸĿ¼
+    void reset();
+
+    const Inode& operator[](uint32_t ino) const {
+        return slots[ino / INODES_PER_PAGE].load(std::memory_order_acquire)->records[ino % INODES_PER_PAGE];
+    }
+    // ȡɸдļ¼ҳʱȸƣ˳־ֶκtouch´αʱд
+    Inode& edit(uint32_t ino) {
+        InodePage* page = slots[ino / INODES_PER_PAGE].load(std::memory_order_acquire);
+        if (page->epoch.load(std::memory_order_relaxed) != epoch) {
+            page = ownPage(ino / INODES_PER_PAGE);
+        }
+        return page->records[ino % INODES_PER_PAGE];
+    }
+    void touch(uint32_t ino) { dirty.mark(ino); }
+    std::string_view name(uint32_t ino) const {
+        const Inode& node = (*this)[ino];
+        return std::string_view(names->data() + node.nameOffset, node.nameLength);
+    }
+
+    uint32_t find(uint32_t dir, std::string_view name) const { return index.find(*this, dir, name); }
+    // dir½һͬѴڻֹʱNO_INODE
+    uint32_t create(uint32_t dir, std::string_view name, bool isDirectory);
+    // Ŀ¼ժ²inode
+    void remove(uint32_t ino);
+    // ƵnewDir²֤߱Ŀֲ
+    bool move(uint32_t ino, uint32_t newDir, std::string_view newName);
+
+    size_t count() const { return inodeCount - freeInodes.size(); }
+    uint32_t size() const { return inodeCount; }     // inodeŵϽ磬е
+    uint64_t memoryUsage() const;
+
+    // ǰĿռԪchainEpochʱûбκο
+    uint32_t currentEpoch() const { return epoch; }
+    // ǰݵֻͼֻҳָ룻֮Ԫ1
+    InodeSnapshot snapshot();
+
+    // inode: [ͷ][¼ x ][ x ]СĶԭд
+    // ӵǰλдinodeֽ
+    uint64_t save(std::ostream& os) const;
+    // saveдļΪԺsaveChangesĻ׼
+    void markSaved();
+    uint64_t savedAreaBytes() const;
+    // гҪдصͷĶļ¼׷ӵ֣ʱfalsesave
+    // дָڵ飬ڱٴθĶǰЧ
+    bool saveChanges(std::vector<ImageWrite>& out, uint64_t areaOffset);
+    bool load(std::istream& is);
+};
\ No newline at end of file
@@ -0,0 +1,393 @@
+// IoEngine.cpp
+#include "IoEngine.h"
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+// ͬĶλд̳߳غio_uringֵ֧Ĳ
+// һֻһʱŶдʣµģֱꡢļĩβǰѴʱѴֽ
+static int64_t syncIo(intptr_t file, const IoRequest& r) {
+    uint32_t moved = 0;
+    while (moved < r.len) {
+        uint64_t offset = r.offset + moved;
+        char* buf = r.buf + moved;
+        uint32_t len = r.len - moved;
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        ov.Offset = DWORD(offset);
+        ov.OffsetHigh = DWORD(offset >> 32);
+        DWORD n = 0;
+        BOOL ok = r.write ? WriteFile(reinterpret_cast<HANDLE>(file), buf, len, &n, &ov)
+                          : ReadFile(reinterpret_cast<HANDLE>(file), buf, len, &n, &ov);
+        if (!ok && GetLastError() != ERROR_HANDLE_EOF) {
+            return moved > 0 ? int64_t(moved) : -int64_t(GetLastError());
+        }
+#else
+        ssize_t n = r.write ? pwrite(static_cast<int>(file), buf, len, static_cast<off_t>(offset))
+                            : pread(static_cast<int>(file), buf, len, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return moved > 0 ? int64_t(moved) : -int64_t(errno);
+        }
+#endif
+        if (n == 0) break;
+        moved += static_cast<uint32_t>(n);
+    }
+    return moved;
+}
+
+ThreadPoolEngine::ThreadPoolEngine(unsigned threads) : stopping(false) {
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPoolEngine::work, this);
+    }
+}
+
+ThreadPoolEngine::~ThreadPoolEngine() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPoolEngine::work() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        ready.wait(guard, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+
+        Task task = queue.front();
+        queue.pop_front();
+        guard.unlock();
+        task.request->result = syncIo(task.file, *task.request);
+        guard.lock();
+        if (--task.batch->remaining == 0) {
+            task.batch->done.notify_all();
+        }
+    }
+}
+
+void ThreadPoolEngine::run(intptr_t file, IoRequest* requests, size_t count) {
+    if (count == 0) return;
+    if (count == 1) {
+        requests[0].result = syncIo(file, requests[0]);
+        return;
+    }
+
+    Batch batch;
+    batch.remaining = count;
+    std::unique_lock<std::mutex> guard(lock);
+    for (size_t i = 0; i < count; i++) {
+        queue.push_back(Task{ file, &requests[i], &batch });
+    }
+    ready.notify_all();
+    batch.done.wait(guard, [&batch] { return batch.remaining == 0; });
+}
+
+#ifdef HAVE_IO_URING
+
+// Ȼ;ʱio_uring_enterʧôξͲٵ
+static const unsigned MAX_DRAIN_ATTEMPTS = 100;
+
+// io_uringʵֱ֣ϵͳãliburing
+// ÿͬһʱֻһãʱཨ
+class UringEngine : public IoEngine {
+private:
+    struct Ring {
+        int fd;
+        unsigned entries;
+        unsigned* sqHead;
+        unsigned* sqTail;
+        unsigned sqMask;
+        unsigned* sqArray;
+        io_uring_sqe* sqes;
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        io_uring_cqe* cqes;
+        void* sqMap;
+        size_t sqMapBytes;
+        void* cqMap;
+        size_t cqMapBytes;
+        size_t sqesBytes;
+    };
+
+    unsigned depth;
+    std::mutex lock;
+    std::vector<Ring*> idle;          // еĻ
+    std::vector<Ring*> all;
+
+    static Ring* setup(unsigned entries);
+    static void destroy(Ring* ring);
+    Ring* acquire();
+    void release(Ring* ring);
+
+public:
+    explicit UringEngine(unsigned depth) : depth(depth) {}
+    ~UringEngine();
+    bool init();
+    void run(intptr_t file, IoRequest* requests, size_t count) override;
+    const char* name() const override { return "io_uring"; }
+};
+
+UringEngine::Ring* UringEngine::setup(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) return nullptr;
+
+    Ring* r = new Ring();
+    r->fd = fd;
+    r->entries = params.sq_entries;
+    r->sqMapBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cqMapBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        r->sqMapBytes = r->cqMapBytes = std::max(r->sqMapBytes, r->cqMapBytes);
+    }
+
+    r->sqMap = mmap(nullptr, r->sqMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    r->cqMap = single ? r->sqMap :
+        mmap(nullptr, r->cqMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    r->sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, r->sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqMap == MAP_FAILED || r->cqMap == MAP_FAILED || sqes == MAP_FAILED) {
+        if (r->sqMap != MAP_FAILED) munmap(r->sqMap, r->sqMapBytes);
+        if (!single && r->cqMap != MAP_FAILED) munmap(r->cqMap, r->cqMapBytes);
+        if (sqes != MAP_FAILED) munmap(sqes, r->sqesBytes);
+        close(fd);
+        delete r;
+        return nullptr;
+    }
+
+    char* sq = static_cast<char*>(r->sqMap);
+    char* cq = static_cast<char*>(r->cqMap);
+    r->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    r->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    r->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    r->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    r->sqes = static_cast<io_uring_sqe*>(sqes);
+    r->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    r->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    r->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    r->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return r;
+}
+
+void UringEngine::destroy(Ring* r) {
+    munmap(r->sqes, r->sqesBytes);
+    if (r->cqMap != r->sqMap) munmap(r->cqMap, r->cqMapBytes);
+    munmap(r->sqMap, r->sqMapBytes);
+    close(r->fd);
+    delete r;
+}
+
+UringEngine::~UringEngine() {
+    for (Ring* r : all) {
+        destroy(r);
+    }
+}
+
+// Ƚһȷں֧
+bool UringEngine::init() {
+    Ring* r = setup(depth);
+    if (!r) return false;
+    all.push_back(r);
+    idle.push_back(r);
+    return true;
+}
+
+UringEngine::Ring* UringEngine::acquire() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!idle.empty()) {
+            Ring* r = idle.back();
+            idle.pop_back();
+            return r;
+        }
+    }
+    Ring* r = setup(depth);
+    if (r) {
+        std::lock_guard<std::mutex> guard(lock);
+        all.push_back(r);
+    }
+    return r;
+}
+
+void UringEngine::release(Ring* r) {
+    std::lock_guard<std::mutex> guard(lock);
+    idle.push_back(r);
+}
+
+// Ѵλͬಿ
+static int64_t syncRest(intptr_t file, const IoRequest& r, uint32_t moved) {
+    IoRequest rest = { r.offset + moved, r.buf + moved, r.len - moved, r.write, 0 };
+    int64_t n = syncIo(file, rest);
+    if (n < 0) return moved > 0 ? int64_t(moved) : n;
+    return moved + n;
+}
+
+void UringEngine::run(intptr_t file, IoRequest* requests, size_t count) {
+    Ring* r = (count > 1) ? acquire() : nullptr;
+    if (!r) {
+        for (size_t i = 0; i < count; i++) {
+            requests[i].result = syncIo(file, requests[i]);
+        }
+        return;
+    }
+
+    // ύпλͼÿνںٵȻһ
+    // ֻһֵӶϵ㴦ύmovedǸѴֽ
+    std::vector<uint32_t> moved(count, 0);
+    std::vector<uint8_t> inKernel(count, 0);
+    std::vector<size_t> retry;
+    size_t next = 0;
+    unsigned inFlight = 0;
+    unsigned toSubmit = 0;
+    bool broken = false;
+    unsigned drainFailures = 0;
+    int drainError = 0;
+    for (;;) {
+        unsigned tail = *r->sqTail;
+        unsigned head = __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE);
+        while (!broken && (!retry.empty() || next < count) && inFlight < r->entries && tail - head < r->entries) {
+            size_t i = next;
+            if (!retry.empty()) {
+                i = retry.back();
+                retry.pop_back();
+            }
+            else {
+                next++;
+            }
+            unsigned index = tail & r->sqMask;
+            io_uring_sqe* sqe = &r->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = requests[i].write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd = static_cast<int>(file);
+            sqe->addr = reinterpret_cast<uint64_t>(requests[i].buf + moved[i]);
+            sqe->len = requests[i].len - moved[i];
+            sqe->off = requests[i].offset + moved[i];
+            sqe->user_data = i;
+            inKernel[i] = 1;
+            r->sqArray[index] = index;
+            tail++;
+            inFlight++;
+            toSubmit++;
+        }
+        __atomic_store_n(r->sqTail, tail, __ATOMIC_RELEASE);
+        if (inFlight == 0) break;
+
+        // ύֻѽں˵ɣǻڶдߵĻ壬
+        unsigned waitFor = broken ? inFlight : 1;
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, r->fd, toSubmit, waitFor, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            if (broken) {
+                // һԣһֱʧܾͷʣµ;ʧ
+                if (++drainFailures < MAX_DRAIN_ATTEMPTS) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+                drainError = errno;
+                break;
+            }
+            // ں˻ûȡߵջͬ
+            broken = true;
+            head = __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE);
+            for (unsigned pos = head; pos != tail; pos++) {
+                size_t i = static_cast<size_t>(r->sqes[pos & r->sqMask].user_data);
+                inKernel[i] = 0;
+                retry.push_back(i);
+                inFlight--;
+            }
+            toSubmit = 0;
+            continue;
+        }
+        toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(ret));
+
+        unsigned cqHead = *r->cqHead;
+        unsigned cqTail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+        for (; cqHead != cqTail; cqHead++) {
+            const io_uring_cqe& cqe = r->cqes[cqHead & r->cqMask];
+            size_t i = static_cast<size_t>(cqe.user_data);
+            IoRequest& req = requests[i];
+            inKernel[i] = 0;
+            inFlight--;
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                retry.push_back(i);
+            }
+            else if (cqe.res == -EINVAL) {
+                // ں˲ʶĲͬд
+                req.result = syncRest(file, req, moved[i]);
+            }
+            else if (cqe.res > 0 && moved[i] + uint32_t(cqe.res) < req.len) {
+                moved[i] += static_cast<uint32_t>(cqe.res);
+                retry.push_back(i);
+            }
+            else if (cqe.res < 0) {
+                req.result = moved[i] > 0 ? int64_t(moved[i]) : int64_t(cqe.res);
+            }
+            else {
+                req.result = int64_t(moved[i]) + cqe.res;
+            }
+        }
+        __atomic_store_n(r->cqHead, cqHead, __ATOMIC_RELEASE);
+    }
+
+    if (broken) {
+        // Ȳʧܴصʱں˻ȡ
+        for (size_t i = 0; i < count && inFlight > 0; i++) {
+            if (inKernel[i]) {
+                requests[i].result = moved[i] > 0 ? int64_t(moved[i]) : -int64_t(drainError);
+            }
+        }
+        // صûύջصͬ
+        for (size_t i : retry) {
+            requests[i].result = syncRest(file, requests[i], moved[i]);
+        }
+        for (size_t i = next; i < count; i++) {
+            requests[i].result = syncIo(file, requests[i]);
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            all.erase(std::find(all.begin(), all.end(), r));
+        }
+        destroy(r);
+        return;
+    }
+    release(r);
+}
+
+#endif
+
+std::unique_ptr<IoEngine> IoEngine::create(IoBackend backend, unsigned queueDepth) {
+#ifdef HAVE_IO_URING
+    if (backend != IO_THREADS) {
+        std::unique_ptr<UringEngine> engine(new UringEngine(queueDepth));
+        if (engine->init()) {
+            return std::unique_ptr<IoEngine>(engine.release());
+        }
+    }
+#endif
+    if (backend == IO_URING) {
+        return nullptr;
+    }
+    return std::unique_ptr<IoEngine>(new ThreadPoolEngine(std::min(queueDepth, 8u)));
+}
\ No newline at end of file
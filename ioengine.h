@@ -0,0 +1,67 @@
+// IoEngine.h
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+
+// ѡõ첽I/Oʵ
+enum IoBackend {
+    IO_AUTO,         // ں֧ʱio_uring̳߳
+    IO_URING,        // ֻio_uringʱʧ
+    IO_THREADS,      // ̳߳أ߳ͬĶλд
+};
+
+// һζλдɺresultΪֽʧʱΪĴ
+struct IoRequest {
+    uint64_t offset;
+    char* buf;
+    uint32_t len;
+    bool write;
+    int64_t result;
+};
+
+// 첽I/O棺һһύ汣ֶͬʱ;ȫɺ󷵻
+// Ա߳ͬʱ
+class IoEngine {
+public:
+    virtual ~IoEngine() {}
+    // fileΪPOSIXļWindowsļ
+    virtual void run(intptr_t file, IoRequest* requests, size_t count) = 0;
+    virtual const char* name() const = 0;
+
+    // queueDepthΪͬʱ;ޣܴʱؿ
+    static std::unique_ptr<IoEngine> create(IoBackend backend, unsigned queueDepth);
+};
+
+// ̳߳ʵ֣ŽУɹ߳ͬд
+class ThreadPoolEngine : public IoEngine {
+private:
+    struct Batch {
+        size_t remaining;
+        std::condition_variable done;
+    };
+    struct Task {
+        intptr_t file;
+        IoRequest* request;
+        Batch* batch;
+    };
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<Task> queue;
+    std::vector<std::thread> workers;
+    bool stopping;
+
+    void work();
+
+public:
+    explicit ThreadPoolEngine(unsigned threads);
+    ~ThreadPoolEngine();
+    void run(intptr_t file, IoRequest* requests, size_t count) override;
+    const char* name() const override { return "thread pool"; }
+};
\ No newline at end of file
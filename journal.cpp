@@ -0,0 +1,331 @@
+// Journal.cpp
+#include "Journal.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t JOURNAL_MAGIC = 0x314C4E4A;      // "JNL1"
+static const uint64_t JOURNAL_HEADER_BYTES = 8;         // ħ + Ԫ
+static const uint64_t RECORD_HEADER_BYTES = 8;          //  + CRC
+static const uint64_t MAX_PAGE_BYTES = 1 << 30;         // һPAGE¼Яֽ
+
+// ƽ̨صļ־ͼ㶼Ҫfsync
+#ifdef _WIN32
+
+static int openFile(const std::string& path, bool create) {
+    return _open(path.c_str(), _O_RDWR | _O_BINARY | (create ? _O_CREAT : 0), _S_IREAD | _S_IWRITE);
+}
+static bool seekTo(int fd, uint64_t offset) { return _lseeki64(fd, offset, SEEK_SET) >= 0; }
+static bool truncateTo(int fd, uint64_t bytes) { return _chsize_s(fd, bytes) == 0; }
+static bool syncFd(int fd) { return _commit(fd) == 0; }
+static void closeFd(int fd) { _close(fd); }
+static int64_t writeSome(int fd, const char* data, uint64_t len) {
+    return _write(fd, data, static_cast<unsigned>(std::min<uint64_t>(len, 1u << 30)));
+}
+
+#else
+
+static int openFile(const std::string& path, bool create) {
+    return ::open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+}
+static bool seekTo(int fd, uint64_t offset) { return lseek(fd, static_cast<off_t>(offset), SEEK_SET) >= 0; }
+static bool truncateTo(int fd, uint64_t bytes) { return ftruncate(fd, static_cast<off_t>(bytes)) == 0; }
+static bool syncFd(int fd) { return fsync(fd) == 0; }
+static void closeFd(int fd) { ::close(fd); }
+static int64_t writeSome(int fd, const char* data, uint64_t len) {
+    return ::write(fd, data, static_cast<size_t>(std::min<uint64_t>(len, 1u << 30)));
+}
+
+#endif
+
+static bool writeAll(int fd, const char* data, uint64_t len) {
+    while (len > 0) {
+        int64_t n = writeSome(fd, data, len);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// CRC-32 (IEEE 802.3) ұ
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+// CRC-32 (IEEE 802.3)߳ͬʱ׷־ұɾֲ̬ĳʼֻһ
+static uint32_t crc32(const char* data, size_t len) {
+    static const CrcTable crcTable;
+    const uint32_t* table = crcTable.entries;
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+bool JournalReader::getU64(uint64_t& value) {
+    if (payload.size() - pos < sizeof(value)) return false;
+    memcpy(&value, payload.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+bool JournalReader::getString(std::string& value) {
+    uint32_t len;
+    if (payload.size() - pos < sizeof(len)) return false;
+    memcpy(&len, payload.data() + pos, sizeof(len));
+    pos += sizeof(len);
+    if (payload.size() - pos < len) return false;
+    value.assign(payload.data() + pos, len);
+    pos += len;
+    return true;
+}
+
+Journal::Journal() : fd(-1), pending(0), groupRecords(1), recordStart(0), durableBytes(0), failed(false) {}
+
+Journal::~Journal() {
+    close();
+}
+
+bool Journal::open(const std::string& path, uint32_t epoch, uint64_t keepBytes) {
+    close();
+    fd = openFile(path, true);
+    if (fd < 0) return false;
+    failed = false;
+
+    if (keepBytes > 0) {
+        // дһβеļ¼׷
+        if (!truncateTo(fd, keepBytes) || !seekTo(fd, keepBytes)) {
+            close();
+            return false;
+        }
+        durableBytes = keepBytes;
+        return true;
+    }
+    if (!reset(epoch)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Journal::close() {
+    if (fd >= 0) {
+        commit();
+        closeFd(fd);
+    }
+    fd = -1;
+    buffer.clear();
+    pending = 0;
+}
+
+void Journal::begin(uint8_t type) {
+    recordStart = buffer.size();
+    buffer.append(RECORD_HEADER_BYTES, '\0');
+    buffer.push_back(static_cast<char>(type));
+}
+
+void Journal::putU64(uint64_t value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void Journal::putString(std::string_view value) {
+    uint32_t len = static_cast<uint32_t>(value.size());
+    buffer.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    buffer.append(value.data(), value.size());
+}
+
+bool Journal::end() {
+    // ϳȺУ飬У鸲ͺ
+    const char* body = buffer.data() + recordStart + RECORD_HEADER_BYTES;
+    uint32_t len = static_cast<uint32_t>(buffer.size() - recordStart - RECORD_HEADER_BYTES);
+    uint32_t crc = crc32(body, len);
+    memcpy(&buffer[recordStart], &len, sizeof(len));
+    memcpy(&buffer[recordStart + sizeof(len)], &crc, sizeof(crc));
+
+    uint8_t type = static_cast<uint8_t>(buffer[recordStart + RECORD_HEADER_BYTES]);
+    if (type >= JR_CHECKPOINT_BEGIN) {
+        return true;
+    }
+    if (failed) {
+        // ǰļ¼ụ̂һȱ֮Ҳ޷
+        buffer.resize(recordStart);
+        return false;
+    }
+    // ύܹһ¼д
+    if (++pending >= groupRecords) {
+        return commit();
+    }
+    return true;
+}
+
+bool Journal::commit() {
+    if (fd < 0 || failed) return false;
+    if (buffer.empty()) return true;
+
+    if (!writeAll(fd, buffer.data(), buffer.size()) || !syncFd(fd)) {
+        failed = true;
+        return false;
+    }
+    durableBytes += buffer.size();
+    buffer.clear();
+    pending = 0;
+    return true;
+}
+
+bool Journal::checkpoint(uint32_t newEpoch, const std::vector<ImageWrite>& writes) {
+    if (fd < 0) return false;
+    if (failed) {
+        // صдһĲ֣û̵ļ¼ɼݴ棻ͷûдʱ޷
+        if (durableBytes < JOURNAL_HEADER_BYTES || !truncateTo(fd, durableBytes) || !seekTo(fd, durableBytes)) {
+            return false;
+        }
+        buffer.clear();
+        pending = 0;
+        failed = false;
+    }
+
+    begin(JR_CHECKPOINT_BEGIN);
+    putU64(newEpoch);
+    end();
+    for (const ImageWrite& w : writes) {
+        for (uint64_t done = 0; done < w.len; done += MAX_PAGE_BYTES) {
+            uint64_t n = std::min(w.len - done, MAX_PAGE_BYTES);
+            begin(JR_PAGE);
+            putU64(w.offset + done);
+            putString(std::string_view(w.data + done, n));
+            end();
+        }
+    }
+    begin(JR_CHECKPOINT_END);
+    putU64(newEpoch);
+    end();
+    return commit();
+}
+
+bool Journal::reset(uint32_t epoch) {
+    if (fd < 0) return false;
+
+    buffer.clear();
+    pending = 0;
+    uint32_t header[2] = { JOURNAL_MAGIC, epoch };
+    if (!truncateTo(fd, 0) || !seekTo(fd, 0) ||
+        !writeAll(fd, reinterpret_cast<const char*>(header), sizeof(header)) || !syncFd(fd)) {
+        failed = true;
+        durableBytes = 0;
+        return false;
+    }
+    durableBytes = JOURNAL_HEADER_BYTES;
+    failed = false;
+    return true;
+}
+
+bool Journal::scan(const std::string& path, JournalScan& out) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    uint32_t header[2];
+    if (data.size() < JOURNAL_HEADER_BYTES) return false;
+    memcpy(header, data.data(), sizeof(header));
+    if (header[0] != JOURNAL_MAGIC) return false;
+
+    out.epoch = header[1];
+    out.entries.clear();
+    out.checkpointDone = false;
+    out.pages.clear();
+
+    std::vector<JournalEntry> checkpointPages;
+    bool inCheckpoint = false;
+    uint64_t checkpointStart = 0;
+    uint64_t pos = JOURNAL_HEADER_BYTES;
+    while (data.size() - pos >= RECORD_HEADER_BYTES) {
+        uint32_t len, crc;
+        memcpy(&len, data.data() + pos, sizeof(len));
+        memcpy(&crc, data.data() + pos + sizeof(len), sizeof(crc));
+        const char* body = data.data() + pos + RECORD_HEADER_BYTES;
+        if (len == 0 || data.size() - pos - RECORD_HEADER_BYTES < len || crc32(body, len) != crc) {
+            break; // дһļ¼
+        }
+
+        JournalEntry entry;
+        entry.type = static_cast<uint8_t>(body[0]);
+        entry.payload.assign(body + 1, len - 1);
+        uint64_t recordPos = pos;
+        pos += RECORD_HEADER_BYTES + len;
+
+        if (entry.type == JR_CHECKPOINT_BEGIN) {
+            inCheckpoint = true;
+            checkpointStart = recordPos;
+            checkpointPages.clear();
+        }
+        else if (entry.type == JR_PAGE) {
+            if (inCheckpoint) checkpointPages.push_back(std::move(entry));
+        }
+        else if (entry.type == JR_CHECKPOINT_END) {
+            // ֮ǰĲѰڼ
+            uint64_t epoch = 0;
+            if (inCheckpoint && JournalReader(entry.payload).getU64(epoch)) {
+                out.checkpointDone = true;
+                out.pages.swap(checkpointPages);
+                out.epoch = static_cast<uint32_t>(epoch);
+                out.entries.clear();
+            }
+            inCheckpoint = false;
+        }
+        else if (!inCheckpoint) {
+            out.entries.push_back(std::move(entry));
+        }
+    }
+
+    // ûдļ㲻û
+    out.validBytes = inCheckpoint ? checkpointStart : pos;
+    return true;
+}
+
+bool Journal::writeAt(const std::string& path, const std::vector<ImageWrite>& writes, bool sync) {
+    int f = openFile(path, false);
+    if (f < 0) return false;
+
+    bool ok = true;
+    for (const ImageWrite& w : writes) {
+        if (!seekTo(f, w.offset) || !writeAll(f, w.data, w.len)) {
+            ok = false;
+            break;
+        }
+    }
+    if (ok && sync) {
+        ok = syncFd(f);
+    }
+    closeFd(f);
+    return ok;
+}
+
+bool Journal::syncFile(const std::string& path) {
+    int f = openFile(path, false);
+    if (f < 0) return false;
+    bool ok = syncFd(f);
+    closeFd(f);
+    return ok;
+}
\ No newline at end of file
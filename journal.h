@@ -0,0 +1,101 @@
+// Journal.h
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// ־¼
+enum JournalRecordType : uint8_t {
+    JR_MKDIR = 1,            // ·
+    JR_RMDIR,                // ·
+    JR_CREATE,               // ·
+    JR_DELETE,               // ·
+    JR_RENAME,               // ԭ·, ·
+    JR_WRITE,                // ·, ļ
+    JR_PWRITE,               // ·, ƫ, 
+    JR_COMPRESS,             // ·, Ƿѹ
+    JR_CHECKPOINT_BEGIN,     // ¼Ԫ
+    JR_PAGE,                 // ļƫ, 
+    JR_CHECKPOINT_END,       // ¼Ԫ
+};
+
+// Ծļһд룬ɵ߳
+struct ImageWrite {
+    uint64_t offset;
+    const char* data;
+    uint64_t len;
+};
+
+struct JournalEntry {
+    uint8_t type;
+    std::string payload;
+};
+
+// ɨ־ļĽ
+struct JournalScan {
+    uint32_t epoch;                          // Щ¼ڵľԪ
+    uint64_t validBytes;                     // ¼ĩβ֮дһļ¼
+    std::vector<JournalEntry> entries;       // ҪĲ¼
+    bool checkpointDone;                     // һļ
+    std::vector<JournalEntry> pages;         // üд뾵
+};
+
+// ȡ־¼ֶ
+class JournalReader {
+private:
+    const std::string& payload;
+    size_t pos;
+
+public:
+    explicit JournalReader(const std::string& payload) : payload(payload), pos(0) {}
+    bool getU64(uint64_t& value);
+    bool getString(std::string& value);
+};
+
+// ԪԤд־
+// ÿ¼ȺCRC׷ڴ滺ܹһһwriteһfsync
+// ȰҪд־̣ԭддض־
+// дʧܺ־ȱڣ˺ļ¼ύֱܾһμڴе״̬
+class Journal {
+private:
+    int fd;                      // ־ļδʱΪ-1
+    std::string buffer;          // δύļ¼
+    uint32_t pending;            // еĲ¼
+    uint32_t groupRecords;       // ܹύһ
+    size_t recordStart;          // ڹļ¼ڻе
+    uint64_t durableBytes;       // д벢fsync־
+    bool failed;                 // ύʧܹļ¼û
+
+public:
+    Journal();
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // ½־ֻͷkeepBytes0ʱԭļǰkeepBytesֽڼ׷
+    bool open(const std::string& path, uint32_t epoch, uint64_t keepBytes = 0);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+    void setGroupRecords(uint32_t records) { groupRecords = records ? records : 1; }
+
+    // ֶιһ¼endʱУ鲢ύ־ʧܻύʧʱfalse
+    void begin(uint8_t type);
+    void putU64(uint64_t value);
+    void putString(std::string_view value);
+    bool end();
+
+    // ѻеļ¼д־fsyncʧʱ¼ڻ־Ϊʧ
+    bool commit();
+    bool isFailed() const { return failed; }
+    // ¼Ҫд뾵ȫݲ̣־ʧܹʱȶû̵Ĳ֣ǵĽ
+    bool checkpoint(uint32_t newEpoch, const std::vector<ImageWrite>& writes);
+    // д־¼Ԫʼ
+    bool reset(uint32_t epoch);
+
+    // ־ļ¼ļڻͷЧʱfalse
+    static bool scan(const std::string& path, JournalScan& out);
+    // ƫдļsyncΪʱдfsync
+    static bool writeAt(const std::string& path, const std::vector<ImageWrite>& writes, bool sync);
+    static bool syncFile(const std::string& path);
+};
\ No newline at end of file
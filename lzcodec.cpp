@@ -0,0 +1,188 @@
+// LzCodec.cpp
+#include "LzCodec.h"
+#include <cstring>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 0xFFFF;
+static const int HASH_BITS = 13;
+static const size_t LAST_LITERALS = 5;       // ĩβôֽΪƥչʱֽڲ߽
+
+static inline uint32_t load32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t load64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// ͵ķ0λ±꣬xΪ0
+static inline int lowestBit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return static_cast<int>(i);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+static inline uint32_t hashOf(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// дȵӳ֣ɸ255һС255ֽ
+static inline char* putLength(char* op, size_t n) {
+    while (n >= 255) {
+        *op++ = static_cast<char>(255);
+        n -= 255;
+    }
+    *op++ = static_cast<char>(n);
+    return op;
+}
+
+// дһΣ[anchor, anchor+literals)֮ƫoffsetmatchLenƥ䣬matchLenΪ0ʾһ
+static char* putSequence(char* op, char* end, const char* anchor, size_t literals, size_t offset, size_t matchLen) {
+    size_t worst = 1 + literals / 255 + 1 + literals + 2 + matchLen / 255 + 1;
+    if (static_cast<size_t>(end - op) < worst) {
+        return nullptr;
+    }
+    char* token = op++;
+    uint8_t t = static_cast<uint8_t>(literals >= 15 ? 15 : literals) << 4;
+    if (literals >= 15) {
+        op = putLength(op, literals - 15);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+    if (matchLen > 0) {
+        *op++ = static_cast<char>(offset & 0xFF);
+        *op++ = static_cast<char>(offset >> 8);
+        size_t m = matchLen - MIN_MATCH;
+        t |= static_cast<uint8_t>(m >= 15 ? 15 : m);
+        if (m >= 15) {
+            op = putLength(op, m - 15);
+        }
+    }
+    *token = static_cast<char>(t);
+    return op;
+}
+
+size_t LzCodec::compress(const char* src, size_t len, char* dst, size_t capacity) {
+    char* op = dst;
+    char* end = dst + capacity;
+    const char* anchor = src;
+
+    if (len > LAST_LITERALS + MIN_MATCH) {
+        // λü10ʾ
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+        const char* limit = src + len - LAST_LITERALS;
+        const char* ip = src;
+        while (ip + MIN_MATCH <= limit) {
+            uint32_t seq = load32(ip);
+            uint32_t& slot = table[hashOf(seq)];
+            const char* cand = slot ? src + slot - 1 : nullptr;
+            slot = static_cast<uint32_t>(ip - src) + 1;
+            if (!cand || size_t(ip - cand) > MAX_OFFSET || load32(cand) != seq) {
+                // Ҳƥʱ𽥼Ӵ󲽳ѹݺܿɨȥ
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // 8ֽһȣͬʱ͵ĲͬλֽͬСˣ
+            size_t matchLen = MIN_MATCH;
+            while (ip + matchLen + 8 <= limit) {
+                uint64_t diff = load64(cand + matchLen) ^ load64(ip + matchLen);
+                if (diff) {
+                    matchLen += lowestBit(diff) / 8;
+                    break;
+                }
+                matchLen += 8;
+            }
+            if (ip + matchLen + 8 > limit) {
+                while (ip + matchLen < limit && cand[matchLen] == ip[matchLen]) {
+                    matchLen++;
+                }
+            }
+            op = putSequence(op, end, anchor, ip - anchor, ip - cand, matchLen);
+            if (!op) return 0;
+            ip += matchLen;
+            anchor = ip;
+        }
+    }
+
+    op = putSequence(op, end, anchor, src + len - anchor, 0, 0);
+    return op ? static_cast<size_t>(op - dst) : 0;
+}
+
+// ȵӳ
+static inline bool getLength(const uint8_t*& ip, const uint8_t* end, size_t& n) {
+    uint8_t b;
+    do {
+        if (ip >= end) return false;
+        b = *ip++;
+        n += b;
+    } while (b == 255);
+    return true;
+}
+
+bool LzCodec::decompress(const char* src, size_t len, char* dst, size_t outLen) {
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* iend = ip + len;
+    char* op = dst;
+    char* oend = dst + outLen;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals < 15 && iend - ip >= 16 && oend - op >= 16) {
+            // һθ16ֽڣĲ󱻸
+            memcpy(op, ip, 16);
+        }
+        else {
+            if (literals == 15 && !getLength(ip, iend, literals)) return false;
+            if (size_t(iend - ip) < literals || size_t(oend - op) < literals) return false;
+            memcpy(op, ip, literals);
+        }
+        ip += literals;
+        op += literals;
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !getLength(ip, iend, matchLen)) return false;
+        matchLen += MIN_MATCH;
+        if (offset == 0 || offset > size_t(op - dst) || size_t(oend - op) < matchLen) return false;
+
+        // ƫƲС8ʱÿθ8ֽڻ16ֽڣĩβдļֽ֮ᱻǣ
+        // صҪֽڸƲظģʽ
+        const char* from = op - offset;
+        char* matchEnd = op + matchLen;
+        if (offset >= 16 && size_t(oend - op) >= 32 && matchLen <= 16) {
+            memcpy(op, from, 16);
+            op = matchEnd;
+        }
+        else if (offset >= 8 && size_t(oend - matchEnd) >= 8) {
+            while (op < matchEnd) {
+                memcpy(op, from, 8);
+                op += 8;
+                from += 8;
+            }
+            op = matchEnd;
+        }
+        else {
+            while (op < matchEnd) {
+                *op++ = *from++;
+            }
+        }
+    }
+    return op == oend;
+}
@@ -0,0 +1,15 @@
+// LzCodec.h
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// LZ77ϵĿѹʽLZ4ĿʽͬÿΪ[][][2ֽƫ][ӳƥ䳤]
+// Ǹ4λȡ4λƥ䳤ȼ4ȡ15ʱֽӳһֻ
+// ѹֻһ̰ƥ䣬׷ѹʣѹб߽磬ʱfalseԽ
+class LzCodec {
+public:
+    // ѹsrcdstcapacityֽʱ0򷵻ѹֽ
+    static size_t compress(const char* src, size_t len, char* dst, size_t capacity);
+    // srcѹdstĳǡΪoutLen
+    static bool decompress(const char* src, size_t len, char* dst, size_t outLen);
+};
@@ -0,0 +1,145 @@
+// MappedFile.cpp
+#include "MappedFile.h"
+#include <utility>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : base(nullptr), length(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+
+bool MappedFile::open(const std::string& path, uint64_t bytes) {
+    close();
+    if (bytes == 0) return false;
+
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(h, &fileSize) || uint64_t(fileSize.QuadPart) < bytes) {
+        CloseHandle(h);
+        return false;
+    }
+
+    HANDLE m = CreateFileMappingA(h, nullptr, PAGE_READWRITE, DWORD(bytes >> 32), DWORD(bytes), nullptr);
+    if (!m) {
+        CloseHandle(h);
+        return false;
+    }
+    void* p = MapViewOfFile(m, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(bytes));
+    if (!p) {
+        CloseHandle(m);
+        CloseHandle(h);
+        return false;
+    }
+
+    file = h;
+    mapping = m;
+    base = static_cast<char*>(p);
+    length = bytes;
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) {
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        CloseHandle(file);
+    }
+    base = nullptr;
+    length = 0;
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+}
+
+bool MappedFile::sync() {
+    if (!base) return false;
+    return FlushViewOfFile(base, 0) && FlushFileBuffers(file);
+}
+
+bool MappedFile::sync(uint64_t offset, uint64_t bytes) {
+    if (!base || offset >= length) return false;
+    bytes = std::min(bytes, length - offset);
+    return FlushViewOfFile(base + offset, static_cast<SIZE_T>(bytes)) != 0;
+}
+
+void MappedFile::swap(MappedFile& other) {
+    std::swap(base, other.base);
+    std::swap(length, other.length);
+    std::swap(file, other.file);
+    std::swap(mapping, other.mapping);
+}
+
+#else
+
+MappedFile::MappedFile() : base(nullptr), length(0), fd(-1) {}
+
+bool MappedFile::open(const std::string& path, uint64_t bytes) {
+    close();
+    if (bytes == 0) return false;
+
+    int f = ::open(path.c_str(), O_RDWR);
+    if (f < 0) return false;
+
+    struct stat st;
+    if (fstat(f, &st) != 0 || uint64_t(st.st_size) < bytes) {
+        ::close(f);
+        return false;
+    }
+
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, f, 0);
+    if (p == MAP_FAILED) {
+        ::close(f);
+        return false;
+    }
+
+    fd = f;
+    base = static_cast<char*>(p);
+    length = bytes;
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) {
+        munmap(base, length);
+        ::close(fd);
+    }
+    base = nullptr;
+    length = 0;
+    fd = -1;
+}
+
+bool MappedFile::sync() {
+    if (!base) return false;
+    return msync(base, length, MS_SYNC) == 0;
+}
+
+bool MappedFile::sync(uint64_t offset, uint64_t bytes) {
+    if (!base || offset >= length) return false;
+
+    // msyncҪʼַҳ
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t start = offset / page * page;
+    uint64_t end = std::min(offset + bytes, length);
+    return msync(base + start, end - start, MS_SYNC) == 0;
+}
+
+void MappedFile::swap(MappedFile& other) {
+    std::swap(base, other.base);
+    std::swap(length, other.length);
+    std::swap(fd, other.fd);
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+// MappedFile.h
+#pragma once
+#include <string>
+#include <cstdint>
+
+// ļǰֽԿɶдķʽӳڴ
+// ӳ޸ֱ䵽ļҳϣҳڵһηʱŵ
+class MappedFile {
+private:
+    char* base;              // ӳʼַδӳʱΪnullptr
+    uint64_t length;         // ӳֽ
+#ifdef _WIN32
+    void* file;              // ļ
+    void* mapping;           // ӳ
+#else
+    int fd;                  // ļ
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // ӳļǰbytesֽڣļʱʧ
+    bool open(const std::string& path, uint64_t bytes);
+    void close();
+    // ӳ޸Ĺҳдļ
+    bool sync();
+    // ֻд[offset, offset+bytes)ڵҳ
+    bool sync(uint64_t offset, uint64_t bytes);
+    void swap(MappedFile& other);
+
+    bool isOpen() const { return base != nullptr; }
+    char* data() const { return base; }
+    uint64_t size() const { return length; }
+};
\ No newline at end of file